@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace benchmarks {
+
+/*
+ * Запросы make_base размером около target_size байт в том виде, как их присылают: с отступами
+ * по строкам, как input_make_base.txt. Сначала все остановки с расстояниями до четырех случайных
+ * остановок, затем автобусы: каждый идет от случайной остановки по этим расстояниям.
+ * stop_share - доля остановок в размере входа, при 1 автобусов нет. Генератор с фиксированным
+ * зерном, поэтому при одних параметрах вход всегда одинаковый. Матрица маршрутов не сохраняется
+ * (routing_table lazy)
+ */
+inline std::string MakeBaseInput(size_t target_size, double stop_share = 0.55,
+                                 std::string_view file = "transport_catalogue.db") {
+    using namespace std::literals;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> latitude(43.5, 43.7);
+    std::uniform_real_distribution<double> longitude(39.6, 39.9);
+    std::uniform_int_distribution<int> distance(100, 5000);
+
+    // Запись остановки занимает около 460 байт
+    const size_t stop_count = std::max<size_t>(target_size * stop_share / 460, 100);
+    std::uniform_int_distribution<size_t> stop_index(0, stop_count - 1);
+    auto stop_name = [](size_t index) {
+        return "Остановка номер "s + std::to_string(index);
+    };
+
+    std::string text;
+    text.reserve(target_size + (1 << 16));
+    text += "{\n    \"serialization_settings\": {\n        \"file\": \""s + std::string(file)
+        + "\",\n        \"routing_table\": \"lazy\"\n    },\n"s;
+    text += "    \"routing_settings\": {\n        \"bus_wait_time\": 2,\n        \"bus_velocity\": 30\n    },\n"
+            "    \"render_settings\": {\n        \"width\": 1500,\n        \"height\": 950,\n        \"padding\": 50,\n"
+            "        \"stop_radius\": 3,\n        \"line_width\": 10,\n        \"bus_label_font_size\": 18,\n"
+            "        \"bus_label_offset\": [7, 15],\n        \"stop_label_font_size\": 13,\n"
+            "        \"stop_label_offset\": [7, -3],\n        \"underlayer_color\": [255, 255, 255, 0.85],\n"
+            "        \"underlayer_width\": 3,\n        \"color_palette\": [\"red\", \"green\", \"blue\", \"brown\", \"orange\"]\n"
+            "    },\n    \"base_requests\": [\n"sv;
+
+    std::ostringstream number;
+    number.precision(9);
+    std::vector<std::array<size_t, 4>> neighbours(stop_count);
+    for (size_t i = 0; i < stop_count; ++i) {
+        if (i > 0) {
+            text += ",\n"sv;
+        }
+        number.str({});
+        number << latitude(generator) << ",\n            \"longitude\": "sv << longitude(generator);
+        text += "        {\n            \"type\": \"Stop\",\n            \"name\": \""s + stop_name(i)
+            + "\",\n            \"latitude\": "s + number.str() + ",\n            \"road_distances\": {\n"s;
+        for (size_t k = 0; k < 4; ++k) {
+            neighbours[i][k] = stop_index(generator);
+            text += "                \""s + stop_name(neighbours[i][k]) + "\": "s
+                + std::to_string(distance(generator)) + (k + 1 < 4 ? ",\n"s : "\n"s);
+        }
+        text += "            }\n        }"sv;
+    }
+    for (size_t i = 0; stop_share < 1 && text.size() < target_size; ++i) {
+        text += ",\n        {\n            \"type\": \"Bus\",\n            \"name\": \"Автобус "s + std::to_string(i)
+            + "\",\n            \"stops\": [\n"s;
+        std::uniform_int_distribution<size_t> neighbour_index(0, 3);
+        size_t stop = stop_index(generator);
+        for (int k = 0; k < 10; ++k) {
+            text += "                \""s + stop_name(stop) + (k + 1 < 10 ? "\",\n"s : "\"\n"s);
+            stop = neighbours[stop][neighbour_index(generator)];
+        }
+        text += "            ],\n            \"is_roundtrip\": false\n        }"sv;
+    }
+    text += "\n    ]\n}\n"sv;
+    return text;
+}
+
+} // namespace benchmarks
@@ -0,0 +1,98 @@
+#include "base_input.h"
+#include "json.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+using namespace std;
+using namespace std::literals;
+
+namespace {
+
+// Получатель событий, который только считает их
+class CountingHandler : public json::Handler {
+public:
+    void StartDict() override { ++events_; }
+    void Key(string) override { ++events_; }
+    void EndDict() override { ++events_; }
+    void StartArray() override { ++events_; }
+    void EndArray() override { ++events_; }
+    void Value(json::Node::Value) override { ++events_; }
+
+    size_t GetEventCount() const {
+        return events_;
+    }
+
+private:
+    size_t events_ = 0;
+};
+
+// Лучшее время из нескольких запусков, в секундах. Подготовка аргумента prepare
+// и разрушение результата function в замер не входят
+template <typename Prepare, typename Function>
+double MeasureBest(int runs, Prepare prepare, Function function) {
+    double best = 0;
+    for (int run = 0; run < runs; ++run) {
+        auto argument = prepare();
+        const auto start = chrono::steady_clock::now();
+        const auto result = function(move(argument));
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+void Report(string_view name, size_t bytes, double seconds) {
+    cout << name << ": "sv << bytes / seconds / 1e6 << " MB/s ("sv << seconds * 1000 << " ms)"sv << endl;
+}
+
+} // namespace
+
+// json_parse_benchmark [размер входа в МБ, по умолчанию 64] [файл]
+// С именем файла только записывает в него вход, например для замера make_base
+int main(int argc, char* argv[]) {
+    const size_t megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 64;
+    const string text = benchmarks::MakeBaseInput(megabytes << 20);
+    if (argc > 2) {
+        ofstream(argv[2], ios::binary) << text;
+        return 0;
+    }
+    cout << "input: "sv << text.size() << " bytes"sv << endl;
+    const int runs = 5;
+
+    // Документ make_base, базы в памяти
+    Report("Load (json::Node)"sv, text.size(), MeasureBest(runs, [] { return 0; }, [&](int) {
+        json::Document document = json::Load(string_view(text));
+        if (!document.GetRoot().IsMap()) {
+            abort();
+        }
+        return document;
+    }));
+
+    // Так читаются stat_requests
+    Report("LoadFlat (json::FlatNode)"sv, text.size(), MeasureBest(runs, [&] { return text; }, [](string copy) {
+        json::FlatDocument document = json::LoadFlat(move(copy));
+        if (!document.GetRoot().IsMap()) {
+            abort();
+        }
+        return document;
+    }));
+
+    // Так make_base читает base_requests
+    Report("Parse (events from istream)"sv, text.size(), MeasureBest(runs, [&] { return text; }, [](string copy) {
+        istringstream input(move(copy));
+        CountingHandler handler;
+        json::Parse(input, handler);
+        if (handler.GetEventCount() == 0) {
+            abort();
+        }
+        return handler.GetEventCount();
+    }));
+}
@@ -0,0 +1,94 @@
+#include "base_input.h"
+#include "serialization.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+using namespace std;
+using namespace std::literals;
+
+namespace {
+
+// Счётчик глобального operator new
+size_t allocation_count = 0;
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* pointer = malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+namespace {
+
+size_t CountRecords(string_view text) {
+    size_t count = 0;
+    for (size_t position = text.find("\"type\""sv); position != string_view::npos;
+         position = text.find("\"type\""sv, position + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+struct Measurement {
+    double seconds;
+    size_t allocations;
+};
+
+// Лучшее время из нескольких запусков make_base. Число выделений от запуска к запуску не меняется
+Measurement MeasureMakeBase(const string& text) {
+    const int runs = 5;
+    Measurement best{0, 0};
+    for (int run = 0; run < runs; ++run) {
+        istringstream input(text);
+        const size_t allocations_before = allocation_count;
+        const auto start = chrono::steady_clock::now();
+        {
+            serialization::Serializer serializer;
+            serializer.SerializeFromInput(input);
+        }
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best.seconds) {
+            best = {seconds, allocation_count - allocations_before};
+        }
+    }
+    return best;
+}
+
+void Report(string_view name, const string& text) {
+    const size_t record_count = CountRecords(text);
+    const Measurement measurement = MeasureMakeBase(text);
+    cout << name << ": "sv << text.size() << " bytes, "sv << record_count << " records, "sv
+         << measurement.seconds * 1000 << " ms, "sv << measurement.allocations << " allocations ("sv
+         << 1.0 * measurement.allocations / record_count << " per record)"sv << endl;
+}
+
+} // namespace
+
+// make_base_benchmark [размер входа в МБ, по умолчанию 8]
+// Замеряет make_base целиком: разбор, сборку каталога и графа, запись базы во временный файл.
+// На входе без автобусов время уходит в основном на разбор записей base_requests
+int main(int argc, char* argv[]) {
+    const size_t megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 8;
+    const string base_file = "make_base_benchmark.db"s;
+    Report("stops only"sv, benchmarks::MakeBaseInput(megabytes << 20, 1.0, base_file));
+    Report("stops and buses"sv, benchmarks::MakeBaseInput(megabytes << 20, 0.55, base_file));
+    remove(base_file.c_str());
+}
@@ -0,0 +1,120 @@
+#include "base_input.h"
+#include "json_reader.h"
+#include "number_format.h"
+#include "serialization.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace std::literals;
+
+namespace {
+
+// Лучшее время из нескольких запусков, в секундах
+template <typename Function>
+double MeasureBest(int runs, Function function) {
+    double best = 0;
+    for (int run = 0; run < runs; ++run) {
+        const auto start = chrono::steady_clock::now();
+        function();
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+void Report(string_view name, size_t count, size_t bytes, double seconds) {
+    cout << name << ": "sv << count / seconds / 1e6 << " M numbers/s, "sv
+         << 1.0 * bytes / count << " bytes per number"sv << endl;
+}
+
+// Координаты в пикселях карты 1500 x 950, как в SVG
+vector<double> MakeCoordinates(size_t count) {
+    mt19937 generator(42);
+    uniform_real_distribution<double> coordinate(0, 1500);
+    vector<double> values(count);
+    for (double& value : values) {
+        value = coordinate(generator);
+    }
+    return values;
+}
+
+void BenchmarkNumbers(size_t count) {
+    const vector<double> values = MakeCoordinates(count);
+    const int runs = 5;
+
+    size_t bytes = 0;
+    const double stream_seconds = MeasureBest(runs, [&] {
+        ostringstream output;
+        for (double value : values) {
+            output << value << ' ';
+        }
+        bytes = output.str().size() - values.size();
+    });
+    Report("ostream"sv, values.size(), bytes, stream_seconds);
+
+    for (int decimals : {-1, 2, 1}) {
+        const double seconds = MeasureBest(runs, [&] {
+            char buffer[numbers::MAX_LENGTH];
+            bytes = 0;
+            for (double value : values) {
+                bytes += numbers::ToChars(value, {decimals}, buffer) - buffer;
+            }
+        });
+        Report(decimals < 0 ? "ToChars, 6 significant digits"s : "ToChars, decimals = "s + to_string(decimals),
+               values.size(), bytes, seconds);
+    }
+}
+
+// Размер ответа на запрос Map для базы из input. svg_precision < 0 - без этого параметра
+size_t MeasureMapSize(string input, int svg_precision, const string& base_file) {
+    if (svg_precision >= 0) {
+        const string anchor = "\"underlayer_width\": 3,"s;
+        input.insert(input.find(anchor) + anchor.size(), " \"svg_precision\": "s + to_string(svg_precision) + ","s);
+    }
+    {
+        istringstream base_input(input);
+        serialization::Serializer serializer;
+        serializer.SerializeFromInput(base_input);
+    }
+    serialization::Deserializer base(base_file);
+    request_handler::RequestHandler request_handler(base);
+    istringstream requests("{\"id\": 1, \"type\": \"Map\"}\n"s);
+    ostringstream output;
+    json_reader::ProcessStatRequestsNdjson(requests, request_handler, output);
+    return output.str().size();
+}
+
+void BenchmarkMap(size_t input_size) {
+    const string base_file = "number_format_benchmark.db"s;
+    const string input = benchmarks::MakeBaseInput(input_size, 0.55, base_file);
+    const size_t default_size = MeasureMapSize(input, -1, base_file);
+    cout << "Map, default: "sv << default_size << " bytes"sv << endl;
+    for (int svg_precision : {2, 1}) {
+        const size_t size = MeasureMapSize(input, svg_precision, base_file);
+        cout << "Map, svg_precision "sv << svg_precision << ": "sv << size << " bytes ("sv
+             << 100.0 * size / default_size - 100 << "%)"sv << endl;
+    }
+    remove(base_file.c_str());
+}
+
+} // namespace
+
+// number_format_benchmark [чисел в миллионах, по умолчанию 2] [размер входа make_base в МБ, по умолчанию 4]
+// Скорость и длина записи чисел разными способами, затем размер полной карты с svg_precision и без
+int main(int argc, char* argv[]) {
+    const size_t millions = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2;
+    const size_t megabytes = argc > 2 ? strtoul(argv[2], nullptr, 10) : 4;
+    BenchmarkNumbers(millions * 1000000);
+    BenchmarkMap(megabytes << 20);
+}
@@ -2,6 +2,7 @@
 
 #include "geo.h"
 
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -10,12 +11,18 @@ namespace domain {
     struct Stop {
         std::string name;
         geo::Coordinates coordinates;
+        // Номер остановки в справочнике, по нему хранятся данные остановки вне справочника
+        size_t id = 0;
     };
 
     struct Bus {
         std::string name;
         std::vector<const Stop*> stops;
         bool is_roundtrip = false;
+        // Уровни масштаба остановок для упрощения линии маршрута, пусто - без упрощения
+        std::vector<uint8_t> stop_zoom_levels;
+        // Номер автобуса в справочнике
+        size_t id = 0;
     };
 
 } // namespace domain
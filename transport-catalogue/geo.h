@@ -13,6 +13,16 @@ struct Coordinates {
     }
 };
 
+// Прямоугольник на карте: min - юго-западный угол, max - северо-восточный
+struct BoundingBox {
+    Coordinates min;
+    Coordinates max;
+    
+    bool Contains(Coordinates point) const {
+        return point.lat >= min.lat && point.lat <= max.lat && point.lng >= min.lng && point.lng <= max.lng;
+    }
+};
+
 double ComputeDistance(Coordinates from, Coordinates to);
 
 }  // namespace geo
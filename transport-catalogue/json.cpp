@@ -1,318 +1,1006 @@
 #include "json.h"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <thread>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
 using namespace std;
+using namespace std::literals;
 
 namespace json {
 
 namespace {
 
-Node LoadNode(istream& input);
+constexpr auto MakeCharTable(string_view chars) {
+    std::array<bool, 256> table{};
+    for (char c : chars) {
+        table[static_cast<unsigned char>(c)] = true;
+    }
+    return table;
+}
 
-Node LoadArray(istream& input) {
-    
-    if (input.peek() == EOF) {
-        throw ParsingError("parsing error");
+constexpr std::array<bool, 256> WHITESPACE = MakeCharTable(" \t\n\r"sv);
+constexpr std::array<bool, 256> STRUCTURAL = MakeCharTable("{}[]:,"sv);
+constexpr std::array<bool, 256> SCALAR_STOP = MakeCharTable(" \t\n\r{}[]:,\""sv);
+constexpr std::array<bool, 256> STRING_STOP = MakeCharTable("\"\\\n\r"sv);
+
+// Словари до такого размера упорядочиваются вставками и просматриваются подряд
+constexpr size_t SMALL_DICT_SIZE = 8;
+
+// Массивы корня и его непосредственных значений, в которых не меньше стольких лексем,
+// разбираются кусками в нескольких потоках
+constexpr size_t PARALLEL_MIN_TOKENS = 1 << 16;
+constexpr int PARALLEL_MAX_DEPTH = 1;
+
+// ---------- Этап 1: структурный индекс ------------------
+
+constexpr size_t BLOCK_SIZE = 64;
+
+// Битовые маски символов блока из 64 байт: бит i соответствует i-му байту
+struct BlockMasks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t structural = 0;
+    uint64_t whitespace = 0;
+    uint64_t line_break = 0;
+};
+
+BlockMasks ClassifyBlockScalar(const char* block) {
+    BlockMasks masks;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        const unsigned char c = block[i];
+        const uint64_t bit = uint64_t{1} << i;
+        if (c == '"') {
+            masks.quote |= bit;
+        } else if (c == '\\') {
+            masks.backslash |= bit;
+        } else if (STRUCTURAL[c]) {
+            masks.structural |= bit;
+        } else if (WHITESPACE[c]) {
+            masks.whitespace |= bit;
+            if (c == '\n' || c == '\r') {
+                masks.line_break |= bit;
+            }
+        }
     }
-    Array result;
-    const set<char> symbols = {' ', '\r', '\n', '\t'};
-    
-    for (char c; input >> noskipws >> c && c != ']';) {
+    return masks;
+}
 
-        if (input.peek() == EOF) {
-            throw ParsingError("parsing error");
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_HAS_X86_SIMD
+
+__attribute__((target("sse2")))
+BlockMasks ClassifyBlockSse2(const char* block) {
+    BlockMasks masks;
+    for (size_t offset = 0; offset < BLOCK_SIZE; offset += 16) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + offset));
+        const __m128i structural = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('{')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('}'))),
+                         _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('[')), _mm_cmpeq_epi8(chars, _mm_set1_epi8(']')))),
+            _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chars, _mm_set1_epi8(','))));
+        const __m128i line_break = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')),
+                                                _mm_cmpeq_epi8(chars, _mm_set1_epi8('\r')));
+        const __m128i whitespace = _mm_or_si128(line_break,
+            _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t'))));
+        masks.quote |= static_cast<uint64_t>(static_cast<uint16_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('"'))))) << offset;
+        masks.backslash |= static_cast<uint64_t>(static_cast<uint16_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\\'))))) << offset;
+        masks.structural |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(structural))) << offset;
+        masks.whitespace |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(whitespace))) << offset;
+        masks.line_break |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(line_break))) << offset;
+    }
+    return masks;
+}
+
+__attribute__((target("avx2")))
+BlockMasks ClassifyBlockAvx2(const char* block) {
+    BlockMasks masks;
+    for (size_t offset = 0; offset < BLOCK_SIZE; offset += 32) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + offset));
+        const __m256i structural = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('}'))),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(']')))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(','))));
+        const __m256i line_break = _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')),
+                                                   _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\r')));
+        const __m256i whitespace = _mm256_or_si256(line_break,
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t'))));
+        masks.quote |= static_cast<uint64_t>(static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('"'))))) << offset;
+        masks.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\\'))))) << offset;
+        masks.structural |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(structural))) << offset;
+        masks.whitespace |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(whitespace))) << offset;
+        masks.line_break |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(line_break))) << offset;
+    }
+    return masks;
+}
+
+#endif
+
+using BlockClassifier = BlockMasks (*)(const char*);
+
+BlockClassifier ChooseBlockClassifier() {
+#ifdef JSON_HAS_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ClassifyBlockAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return ClassifyBlockSse2;
+    }
+#endif
+    return ClassifyBlockScalar;
+}
+
+const BlockClassifier CLASSIFY_BLOCK = ChooseBlockClassifier();
+
+// Каждый бит результата - xor всех битов аргумента не старше него
+uint64_t PrefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+/*
+ * Позиции, с которых начинаются лексемы документа: структурные символы вне строк,
+ * открывающие и закрывающие кавычки строк, первые символы чисел и литералов.
+ * Между соседними лексемами, кроме содержимого строк, могут быть только пробельные символы
+ */
+vector<uint32_t> BuildStructuralIndex(string_view text) {
+    if (text.size() >= numeric_limits<uint32_t>::max()) {
+        throw ParsingError("document is too large");
+    }
+    vector<uint32_t> index;
+    index.reserve(text.size() / 8 + 16);
+
+    bool is_escape_pending = false;
+    uint64_t inside_string = 0;
+    uint64_t previous_is_scalar = 0;
+    char padded_block[BLOCK_SIZE];
+
+    for (size_t block_begin = 0; block_begin < text.size(); block_begin += BLOCK_SIZE) {
+        const char* block = text.data() + block_begin;
+        if (text.size() - block_begin < BLOCK_SIZE) {
+            memset(padded_block, ' ', BLOCK_SIZE);
+            memcpy(padded_block, block, text.size() - block_begin);
+            block = padded_block;
         }
-        if (symbols.count(c)) {
-            continue;
+        const BlockMasks masks = CLASSIFY_BLOCK(block);
+
+        // Экранированные символы: за каждой неэкранированной обратной косой чертой
+        uint64_t escaped = 0;
+        uint64_t backslash = masks.backslash;
+        if (is_escape_pending) {
+            escaped = 1;
+            backslash &= ~uint64_t{1};
         }
-        if (c != ',') {
-            input.putback(c);
+        is_escape_pending = false;
+        while (backslash) {
+            const int position = __builtin_ctzll(backslash);
+            backslash &= backslash - 1;
+            if (position == BLOCK_SIZE - 1) {
+                is_escape_pending = true;
+                break;
+            }
+            escaped |= uint64_t{1} << (position + 1);
+            backslash &= ~(uint64_t{1} << (position + 1));
         }
-        result.push_back(LoadNode(input));
+
+        const uint64_t quote = masks.quote & ~escaped;
+        const uint64_t string_mask = PrefixXor(quote) ^ inside_string;
+        inside_string = (string_mask >> (BLOCK_SIZE - 1)) ? ~uint64_t{0} : 0;
+
+        if (masks.line_break & string_mask & ~quote) {
+            throw ParsingError("parsing error");
+        }
+
+        const uint64_t scalar = ~(masks.structural | masks.whitespace | quote | string_mask);
+        const uint64_t scalar_start = scalar & ~((scalar << 1) | previous_is_scalar);
+        previous_is_scalar = scalar >> (BLOCK_SIZE - 1);
+
+        uint64_t tokens = (masks.structural & ~string_mask) | quote | scalar_start;
+        while (tokens) {
+            const size_t position = block_begin + __builtin_ctzll(tokens);
+            tokens &= tokens - 1;
+            if (position >= text.size()) {
+                break;
+            }
+            index.push_back(static_cast<uint32_t>(position));
+        }
+    }
+    if (inside_string) {
+        throw ParsingError("parsing error");
     }
+    return index;
+}
+
+// ---------- Разбор скаляров и строк ------------------
 
-    return Node(move(result));
+// Последовательность символов скаляра: до пробельного, структурного символа или кавычки
+string_view ScalarToken(string_view text, size_t begin) {
+    size_t end = begin;
+    while (end < text.size() && !SCALAR_STOP[static_cast<unsigned char>(text[end])]) {
+        ++end;
+    }
+    return text.substr(begin, end - begin);
 }
 
+const char* SkipDigits(const char* it, const char* end) {
+    while (it != end && *it >= '0' && *it <= '9') {
+        ++it;
+    }
+    return it;
+}
 
-Node LoadString(istream& input) {
-    
-    if (input.peek() == EOF) {
+Node ParseNumber(string_view token) {
+    const char* const token_end = token.data() + token.size();
+    const char* begin = token.data();
+    if (begin != token_end && *begin == '+') {
+        ++begin;
+    }
+    const char* it = begin;
+    if (it != token_end && *it == '-') {
+        ++it;
+    }
+    const char* digits_begin = it;
+    if (it != token_end && *it == '0') {
+        ++it;
+    } else {
+        it = SkipDigits(it, token_end);
+    }
+    if (it == digits_begin) {
         throw ParsingError("parsing error");
     }
-    if (input.peek() == '"') {
-        input.ignore(1);
-        return Node("");
+
+    bool is_double = false;
+    if (it != token_end && *it == '.') {
+        is_double = true;
+        const char* fraction_begin = ++it;
+        it = SkipDigits(it, token_end);
+        if (it == fraction_begin) {
+            throw ParsingError("parsing error");
+        }
     }
-    
-    string line;
-    char prev, cur;
-    prev = input.get();
-    
-    while (input.peek() != EOF) {
-        cur = input.get();
-        
-        if (prev == '\\') {
-            if (cur == '\\') {
-                line += '\\';
-            } else if (cur == 'n') {
-                line += '\n';
-            } else if (cur == 'r') {
-                line += '\r';
-            } else if (cur == 't') {
-                line += '\t';
-            } else if (cur == '"') {
-                line += '"';
-            } else {
-                throw ParsingError("parsing error");
-            }
-            if (input.peek() == EOF) {
-                throw ParsingError("parsing error");
-            }
-            prev = input.get();
+    if (it != token_end && (*it == 'e' || *it == 'E')) {
+        is_double = true;
+        ++it;
+        if (it != token_end && (*it == '+' || *it == '-')) {
+            ++it;
+        }
+        const char* exponent_begin = it;
+        it = SkipDigits(it, token_end);
+        if (it == exponent_begin) {
+            throw ParsingError("parsing error");
+        }
+    }
+    if (it != token_end) {
+        throw ParsingError("parsing error");
+    }
+
+    if (!is_double) {
+        int value = 0;
+        const auto [ptr, ec] = from_chars(begin, it, value);
+        if (ec != errc() || ptr != it) {
+            throw ParsingError("parsing error");
+        }
+        return Node(value);
+    }
+    double value = 0;
+    const auto [ptr, ec] = from_chars(begin, it, value);
+    if (ec != errc() || ptr != it) {
+        throw ParsingError("parsing error");
+    }
+    return Node(value);
+}
+
+Node ParseScalar(string_view token) {
+    if (token == "true"sv) {
+        return Node(true);
+    }
+    if (token == "false"sv) {
+        return Node(false);
+    }
+    if (token == "null"sv) {
+        return Node(nullptr);
+    }
+    return ParseNumber(token);
+}
+
+// Содержимое строки между кавычками с раскрытыми escape-последовательностями
+string UnescapeString(string_view raw) {
+    if (raw.find('\\') == string_view::npos) {
+        return string(raw);
+    }
+    string result;
+    result.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] != '\\') {
+            result += raw[i];
             continue;
-        } else {
-            if (cur == '\n' || cur == '\r' || prev == '\n' || prev == '\r') {
-                throw ParsingError("parsing error");
-            }
-            line += prev;
-            if (cur == '"') {
+        }
+        if (++i == raw.size()) {
+            throw ParsingError("parsing error");
+        }
+        switch (raw[i]) {
+            case '"':
+                result += '"';
                 break;
-            }
-            if (input.peek() == EOF) {
+            case '\\':
+                result += '\\';
+                break;
+            case '/':
+                result += '/';
+                break;
+            case 'n':
+                result += '\n';
+                break;
+            case 'r':
+                result += '\r';
+                break;
+            case 't':
+                result += '\t';
+                break;
+            case 'b':
+                result += '\b';
+                break;
+            case 'f':
+                result += '\f';
+                break;
+            default:
                 throw ParsingError("parsing error");
-            }
         }
-        prev = cur;
     }
-    
-    return Node(move(line));
+    return result;
 }
 
-Node LoadDict(istream& input) {
-    if (input.peek() == EOF) {
-        throw ParsingError("parsing error");
+// ---------- Этап 2: построение узлов по индексу ------------------
+
+class IndexCursor {
+protected:
+    string_view text_;
+    const vector<uint32_t>& index_;
+    size_t token_ = 0;
+    
+    IndexCursor(string_view text, const vector<uint32_t>& index)
+        : text_(text)
+        , index_(index) {
     }
-    Dict result;
-    const set<char> symbols = {' ', '\r', '\n', '\t'};
 
-    for (char c; input >> noskipws >> c && c != '}';) {
-        if (input.peek() == EOF) {
+    size_t NextToken() {
+        if (token_ == index_.size()) {
             throw ParsingError("parsing error");
         }
-        if (symbols.count(c)) {
-            continue;
+        return index_[token_++];
+    }
+
+    char PeekToken() const {
+        if (token_ == index_.size()) {
+            throw ParsingError("parsing error");
         }
-        if (c == ',') {
-            input >> c;
+        return text_[index_[token_]];
+    }
+
+    // После элемента контейнера: true - контейнер закончился, false - дальше запятая
+    bool IsContainerEnd(char end) {
+        const char c = text_[NextToken()];
+        if (c == end) {
+            return true;
         }
-        
-        while (c != '"') {
-            if (input.peek() == EOF) {
-                throw ParsingError("parsing error");
+        if (c != ',') {
+            throw ParsingError("parsing error");
+        }
+        return false;
+    }
+
+    // Открывающая кавычка уже прочитана, закрывающая - следующая лексема
+    string_view RawString() {
+        const size_t begin = index_[token_ - 1] + 1;
+        const size_t end = NextToken();
+        return text_.substr(begin, end - begin);
+    }
+
+    void ExpectToken(char expected) {
+        if (text_[NextToken()] != expected) {
+            throw ParsingError("parsing error");
+        }
+    }
+};
+
+class Parser : IndexCursor {
+public:
+    Parser(string_view text, const vector<uint32_t>& index)
+        : IndexCursor(text, index) {
+    }
+
+    Node ParseNode() {
+        const size_t position = NextToken();
+        switch (text_[position]) {
+            case '[':
+                return ParseArray();
+            case '{':
+                return ParseDict();
+            case '"':
+                return Node(UnescapeString(RawString()));
+            default:
+                return ParseScalar(ScalarToken(text_, position));
+        }
+    }
+
+private:
+    // Число объемлющих контейнеров
+    int depth_ = 0;
+
+    Node ParseArray() {
+        Array result;
+        if (PeekToken() == ']') {
+            ++token_;
+            return Node(move(result));
+        }
+        if (depth_ <= PARALLEL_MAX_DEPTH && index_.size() - token_ >= PARALLEL_MIN_TOKENS
+            && ParseArrayInParallel(result)) {
+            return Node(move(result));
+        }
+        ++depth_;
+        do {
+            result.push_back(ParseNode());
+        } while (!IsContainerEnd(']'));
+        --depth_;
+        return Node(move(result));
+    }
+
+    Node ParseDict() {
+        Dict result;
+        if (PeekToken() == '}') {
+            ++token_;
+            return Node(move(result));
+        }
+        ++depth_;
+        do {
+            ExpectToken('"');
+            string key = UnescapeString(RawString());
+            ExpectToken(':');
+            Node value = ParseNode();
+            result.emplace(move(key), move(value));
+        } while (!IsContainerEnd('}'));
+        --depth_;
+        return Node(move(result));
+    }
+
+    /*
+     * По индексу находятся запятые между элементами массива, элементы делятся на куски
+     * с примерно равным числом лексем, куски разбираются отдельными парсерами в своих потоках
+     * и склеиваются по порядку. false - массив мал, второго ядра нет или скобки не сошлись:
+     * тогда массив разбирается обычным образом, и ошибка, если она есть, найдется там
+     */
+    bool ParseArrayInParallel(Array& result) {
+        const size_t thread_count = thread::hardware_concurrency();
+        if (thread_count < 2) {
+            return false;
+        }
+
+        // Для каждого элемента - лексема после него: запятая или закрывающая скобка
+        vector<size_t> separators;
+        int depth = 0;
+        size_t end = token_;
+        for (; end < index_.size(); ++end) {
+            const char c = text_[index_[end]];
+            if (c == '[' || c == '{') {
+                ++depth;
+            } else if (c == ']' || c == '}') {
+                if (depth == 0) {
+                    break;
+                }
+                --depth;
+            } else if (c == ',' && depth == 0) {
+                separators.push_back(end);
             }
-            c = input.get();
         }
-        
-        string key = LoadString(input).AsString();
-        
-        while (c != ':') {
-            if (input.peek() == EOF) {
+        if (end == index_.size() || text_[index_[end]] != ']' || end - token_ < PARALLEL_MIN_TOKENS) {
+            return false;
+        }
+        separators.push_back(end);
+
+        const size_t begin = token_;
+        const size_t chunk_count = min(thread_count, separators.size());
+        vector<future<Array>> chunks;
+        size_t first_element = 0;
+        for (size_t chunk = 1; chunk <= chunk_count && first_element < separators.size(); ++chunk) {
+            const size_t boundary = begin + (end - begin) * chunk / chunk_count;
+            const auto last = lower_bound(separators.begin() + first_element, separators.end(), boundary);
+            const size_t last_element = min<size_t>(last - separators.begin() + 1, separators.size());
+            chunks.push_back(async(launch::async, &Parser::ParseElements, this, cref(separators), first_element, last_element));
+            first_element = last_element;
+        }
+
+        result = chunks.front().get();
+        result.reserve(separators.size());
+        for (size_t chunk = 1; chunk < chunks.size(); ++chunk) {
+            Array elements = chunks[chunk].get();
+            move(elements.begin(), elements.end(), back_inserter(result));
+        }
+        token_ = end + 1;
+        return true;
+    }
+
+    Array ParseElements(const vector<size_t>& separators, size_t first, size_t last) const {
+        Parser parser(text_, index_);
+        parser.token_ = first == 0 ? token_ : separators[first - 1] + 1;
+        // Вложенные массивы куска разбираются в его же потоке
+        parser.depth_ = PARALLEL_MAX_DEPTH + 1;
+        Array elements;
+        elements.reserve(last - first);
+        for (size_t element = first; element < last; ++element) {
+            elements.push_back(parser.ParseNode());
+            if (parser.token_ != separators[element]) {
                 throw ParsingError("parsing error");
             }
-            c = input.get();
+            ++parser.token_;
         }
-        
-        result.insert({move(key), LoadNode(input)});
+        return elements;
     }
+};
 
-    return Node(move(result));
-}
+// Строит плоские узлы в арене. Элементы незавершенных контейнеров копятся
+// на общих стеках и переносятся в арену одним блоком, когда контейнер закрыт
+class FlatParser : IndexCursor {
+public:
+    FlatParser(string_view text, const vector<uint32_t>& index, pmr::memory_resource& arena)
+        : IndexCursor(text, index)
+        , arena_(arena) {
+    }
 
-void ParseDigits(istream& input, string& number_str) {
-    char c = input.peek();
-    while (!input.eof() && isdigit(input.peek())) {
-        input >> c;
-        number_str += c;
+    FlatNode ParseNode() {
+        const size_t position = NextToken();
+        switch (text_[position]) {
+            case '[':
+                return ParseArray();
+            case '{':
+                return ParseDict();
+            case '"':
+                return FlatNode(ParseString());
+            default:
+                return ToFlat(ParseScalar(ScalarToken(text_, position)));
+        }
     }
-}
 
-void ParseWithFirstZero(istream& input, string& number_str) {
-    char c;
-    input >> c;
-    if (c != '.' && c != 'e' && c != 'E') {
-        input.putback(c);
-        return;
+private:
+    pmr::memory_resource& arena_;
+    vector<FlatNode> items_;
+    vector<FlatMember> members_;
+
+    template <typename T>
+    T* CopyToArena(const T* data, size_t size) {
+        T* result = static_cast<T*>(arena_.allocate(max<size_t>(size, 1) * sizeof(T), alignof(T)));
+        copy(data, data + size, result);
+        return result;
     }
-    number_str += c;
-    
-    if (c == 'e' || c == 'E') {
-        if (input.peek() == '+') {
-            input.ignore(1);
-        } else if (input.peek() == '-') {
-            input.ignore(1);
-            number_str += '-';
-        } else if (!isdigit(input.peek())) {
-            throw ParsingError("parsing error");
+
+    static FlatNode ToFlat(const Node& scalar) {
+        if (scalar.IsInt()) {
+            return FlatNode(scalar.AsInt());
         }
-        ParseDigits(input, number_str);
-        return;
+        if (scalar.IsPureDouble()) {
+            return FlatNode(scalar.AsDouble());
+        }
+        if (scalar.IsBool()) {
+            return FlatNode(scalar.AsBool());
+        }
+        return FlatNode(nullptr);
     }
-    
-    if (!isdigit(input.peek())) {
-        return;
+
+    string_view ParseString() {
+        const string_view raw = RawString();
+        if (raw.find('\\') == string_view::npos) {
+            return raw;
+        }
+        const string unescaped = UnescapeString(raw);
+        return string_view(CopyToArena(unescaped.data(), unescaped.size()), unescaped.size());
     }
-    ParseDigits(input, number_str);
-    if (input.peek() != 'e' && input.peek() != 'E') {
-        return;
+
+    FlatNode ParseArray() {
+        if (PeekToken() == ']') {
+            ++token_;
+            return FlatNode(FlatArray());
+        }
+        const size_t begin = items_.size();
+        do {
+            FlatNode item = ParseNode();
+            items_.push_back(item);
+        } while (!IsContainerEnd(']'));
+        const size_t size = items_.size() - begin;
+        FlatArray result(CopyToArena(items_.data() + begin, size), size);
+        items_.resize(begin);
+        return FlatNode(result);
     }
-    input >> c;
-    number_str += c;
-    
-    if (input.peek() == '+') {
-        input.ignore(1);
-    } else if (input.peek() == '-') {
-        input.ignore(1);
-        number_str += '-';
-    } else if (!isdigit(input.peek())) {
-        throw ParsingError("parsing error");
+
+    FlatNode ParseDict() {
+        if (PeekToken() == '}') {
+            ++token_;
+            return FlatNode(FlatDict());
+        }
+        const size_t begin = members_.size();
+        do {
+            ExpectToken('"');
+            const string_view key = ParseString();
+            ExpectToken(':');
+            FlatNode value = ParseNode();
+            members_.push_back({key, value});
+        } while (!IsContainerEnd('}'));
+        
+        // Сортировка устойчива: из повторяющихся ключей остается первый, как в Dict
+        const auto by_key = [] (const FlatMember& lhs, const FlatMember& rhs) {
+            return lhs.key < rhs.key;
+        };
+        if (members_.size() - begin > SMALL_DICT_SIZE) {
+            stable_sort(members_.begin() + begin, members_.end(), by_key);
+        }
+        for (size_t i = begin + 1; i < members_.size(); ++i) {
+            for (size_t j = i; j > begin && by_key(members_[j], members_[j - 1]); --j) {
+                swap(members_[j], members_[j - 1]);
+            }
+        }
+        const auto unique_end = unique(members_.begin() + begin, members_.end(),
+            [] (const FlatMember& lhs, const FlatMember& rhs) {
+                return lhs.key == rhs.key;
+        });
+        const size_t size = unique_end - (members_.begin() + begin);
+        FlatDict result(CopyToArena(members_.data() + begin, size), size);
+        members_.resize(begin);
+        return FlatNode(result);
     }
-    ParseDigits(input, number_str);
-}
+};
 
-void ParseWithFirstNonZero(istream& input, string& number_str) {
-    ParseDigits(input, number_str);
-    ParseWithFirstZero(input, number_str);
-}
+// ---------- Потоковый разбор ------------------
 
-Node LoadNumber(istream& input) {
+constexpr size_t CHUNK_SIZE = 1 << 16;
 
-    bool sign = true;
-    if (input.peek() == '-') {
-        sign = false;
-        input.ignore(1);
-    } else if (input.peek() == '+') {
-        input.ignore(1);
+// Читает поток кусками и сообщает обработчику о каждом элементе документа
+class StreamParser {
+public:
+    StreamParser(istream& input, Handler& handler)
+        : input_(input)
+        , handler_(handler) {
     }
-    
-    char c;
-    string number_str;
 
-    input >> c;
-    if (!isdigit(c)) {
-        throw ParsingError("parsing error");
-    }
-    number_str += c;
-    if (c == '0') {
-        ParseWithFirstZero(input, number_str);
-    } else {
-        ParseWithFirstNonZero(input, number_str);
+    void ParseNode() {
+        switch (NextSignificant()) {
+            case '[':
+                ParseArray();
+                break;
+            case '{':
+                ParseDict();
+                break;
+            case '"':
+                handler_.Value(ParseString());
+                break;
+            default:
+                ReadScalar();
+        }
     }
-    
-    try {
-        
-    if (number_str.find('.') == string::npos && number_str.find('e') == string::npos && number_str.find('E') == string::npos) {
-        if (!sign) {
-            return Node( - stoi(number_str));
+
+private:
+    istream& input_;
+    Handler& handler_;
+    string buffer_;
+    size_t pos_ = 0;
+
+    bool Fill() {
+        if (pos_ < buffer_.size()) {
+            return true;
         }
-        return Node(stoi(number_str));
+        buffer_.resize(CHUNK_SIZE);
+        input_.read(buffer_.data(), CHUNK_SIZE);
+        buffer_.resize(input_.gcount());
+        pos_ = 0;
+        return !buffer_.empty();
     }
-    
-    if (!sign) {
-        return Node( - stod(number_str));
+
+    char Get() {
+        if (!Fill()) {
+            throw ParsingError("parsing error");
+        }
+        return buffer_[pos_++];
     }
-    return Node(stod(number_str));
-        
-    } catch (...) {
+
+    // Первый непробельный символ; он остается непрочитанным
+    char PeekSignificant() {
+        while (Fill()) {
+            while (pos_ < buffer_.size()) {
+                if (!WHITESPACE[static_cast<unsigned char>(buffer_[pos_])]) {
+                    return buffer_[pos_];
+                }
+                ++pos_;
+            }
+        }
         throw ParsingError("parsing error");
     }
-}
 
-Node LoadBool(istream& input) {
-    string word;
-    for (int _ = 0; _ < 4; ++_) {
-        if (!input || input.peek() == EOF) {
-            throw ParsingError("parsing error");
+    char NextSignificant() {
+        const char c = PeekSignificant();
+        ++pos_;
+        return c;
+    }
+
+    void ParseArray() {
+        handler_.StartArray();
+        if (PeekSignificant() == ']') {
+            ++pos_;
+            handler_.EndArray();
+            return;
         }
-        word += input.peek();
-        input.ignore(1);
+        while (true) {
+            ParseNode();
+            const char c = NextSignificant();
+            if (c == ']') {
+                break;
+            }
+            if (c != ',') {
+                throw ParsingError("parsing error");
+            }
+        }
+        handler_.EndArray();
     }
-    if (word == "true") {
-        return Node(true);
+
+    void ParseDict() {
+        handler_.StartDict();
+        if (PeekSignificant() == '}') {
+            ++pos_;
+            handler_.EndDict();
+            return;
+        }
+        while (true) {
+            if (NextSignificant() != '"') {
+                throw ParsingError("parsing error");
+            }
+            handler_.Key(ParseString());
+            if (NextSignificant() != ':') {
+                throw ParsingError("parsing error");
+            }
+            ParseNode();
+            const char c = NextSignificant();
+            if (c == '}') {
+                break;
+            }
+            if (c != ',') {
+                throw ParsingError("parsing error");
+            }
+        }
+        handler_.EndDict();
     }
-    if (word == "fals" && input.peek() == 'e') {
-        input.ignore(1);
-        return Node(false);
+
+    // Открывающая кавычка уже прочитана
+    string ParseString() {
+        string raw;
+        while (true) {
+            if (!Fill()) {
+                throw ParsingError("parsing error");
+            }
+            const size_t begin = pos_;
+            while (pos_ < buffer_.size() && !STRING_STOP[static_cast<unsigned char>(buffer_[pos_])]) {
+                ++pos_;
+            }
+            raw.append(buffer_, begin, pos_ - begin);
+            if (pos_ == buffer_.size()) {
+                continue;
+            }
+            const char c = buffer_[pos_++];
+            if (c == '"') {
+                break;
+            }
+            if (c != '\\') {
+                throw ParsingError("parsing error");
+            }
+            raw += c;
+            raw += Get();
+        }
+        return UnescapeString(raw);
     }
-    throw ParsingError("parsing error");
-}
 
-Node LoadNull(istream& input) {
-    string word;
-    for (int _ = 0; _ < 4; ++_) {
-        if (!input || input.peek() == EOF) {
-            throw ParsingError("parsing error");
+    // Первый символ скаляра уже прочитан
+    void ReadScalar() {
+        string token(1, buffer_[pos_ - 1]);
+        while (Fill()) {
+            const size_t begin = pos_;
+            while (pos_ < buffer_.size() && !SCALAR_STOP[static_cast<unsigned char>(buffer_[pos_])]) {
+                ++pos_;
+            }
+            token.append(buffer_, begin, pos_ - begin);
+            if (pos_ < buffer_.size()) {
+                break;
+            }
         }
-        word += input.peek();
-        input.ignore(1);
+        handler_.Value(ParseScalar(token).GetValue());
     }
-    if (word == "null") {
-        return Node(nullptr);
+};
+
+string ReadAll(istream& input) {
+    string result;
+    while (input) {
+        const size_t old_size = result.size();
+        result.resize(old_size + CHUNK_SIZE);
+        input.read(result.data() + old_size, CHUNK_SIZE);
+        result.resize(old_size + input.gcount());
     }
-    throw ParsingError("parsing error");
+    return result;
 }
 
-Node LoadNode(istream& input) {
- 
-    const set<char> symbols = {'{', '[', '"', '-', 't', 'f', 'n'};
-    
-    char c = input.get();
-    
-    while (true) {
-        if (c == '"') {
-            break;
+// ---------- Вывод ------------------
+
+constexpr std::array<bool, 256> ESCAPED = MakeCharTable("\"\\\n\r"sv);
+
+}  // namespace
+
+// Обходит дерево по ссылкам и копит вывод в буфере, сбрасывая его в поток крупными блоками
+class Printer {
+public:
+    Printer(ostream& output, PrintMode mode, numbers::Format number_format = {})
+        : output_(output)
+        , mode_(mode)
+        , number_format_(number_format) {
+        buffer_.reserve(BUFFER_SIZE);
+    }
+
+    ~Printer() {
+        Flush();
+    }
+
+    void PrintNode(const Node& node) {
+        const Node::Value& value = node.GetValue();
+        if (holds_alternative<nullptr_t>(value)) {
+            Write("null"sv);
+        } else if (holds_alternative<bool>(value)) {
+            Write(get<bool>(value) ? "true"sv : "false"sv);
+        } else if (holds_alternative<int>(value)) {
+            PrintNumber(get<int>(value));
+        } else if (holds_alternative<double>(value)) {
+            PrintNumber(get<double>(value));
+        } else if (holds_alternative<string>(value)) {
+            PrintString(get<string>(value));
+        } else if (holds_alternative<Array>(value)) {
+            PrintArray(get<Array>(value));
+        } else {
+            PrintDict(get<Dict>(value));
         }
-        if (c == '\\') {
-            if (input.peek() == 'n' || input.peek() == 'r' || input.peek() == 't') {
-                input.ignore(1);
-                c = input.get();
+    }
+
+    void PrintString(string_view str) {
+        Write("\""sv);
+        size_t begin = 0;
+        for (size_t i = 0; i < str.size(); ++i) {
+            const char c = str[i];
+            if (!ESCAPED[static_cast<unsigned char>(c)]) {
                 continue;
             }
-            if (input.peek() == '"') {
-                c = '"';
-                input.ignore(1);
-                break;
+            Write(str.substr(begin, i - begin));
+            if (c == '\n') {
+                Write("\\n"sv);
+            } else if (c == '\r') {
+                Write("\\r"sv);
+            } else if (c == '"') {
+                Write("\\\""sv);
+            } else {
+                Write("\\\\"sv);
             }
+            begin = i + 1;
         }
-        if (c == ' ' || escape_symbols.count(c)) {
-            c = input.get();
-            continue;
+        Write(str.substr(begin));
+        Write("\""sv);
+    }
+
+    void Flush() {
+        output_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+
+    void Write(string_view text) {
+        if (buffer_.size() + text.size() > BUFFER_SIZE) {
+            Flush();
+            if (text.size() >= BUFFER_SIZE) {
+                output_.write(text.data(), text.size());
+                return;
+            }
         }
-        if (!isdigit(c) && symbols.count(c) == 0) {
-            throw ParsingError("parsing error");
+        buffer_.append(text);
+    }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+    ostream& output_;
+    PrintMode mode_;
+    numbers::Format number_format_;
+    string buffer_;
+    int indent_ = 0;
+
+    // Целые - как есть, вещественные - в формате number_format_
+    template <typename Number>
+    void PrintNumber(Number value) {
+        char chars[numbers::MAX_LENGTH];
+        char* last = nullptr;
+        if constexpr (is_same_v<Number, double>) {
+            last = numbers::ToChars(value, number_format_, chars);
+        } else {
+            last = to_chars(begin(chars), end(chars), value).ptr;
         }
-        break;
+        Write(string_view(chars, last - chars));
     }
-    
-    if (c == '[') {
-        return LoadArray(input);
-    } else if (c == '{') {
-        return LoadDict(input);
-    } else if (c == '"') {
-       // cout << "LoadString" << endl;
-        return LoadString(input);
-    } else if (c == 't' || c == 'f') {
-        input.putback(c);
-        return LoadBool(input);
-    } else if (c == 'n') {
-        input.putback(c);
-        return LoadNull(input);
-    } else {
-        input.putback(c);
-        return LoadNumber(input);
+
+    void NewLine() {
+        Write("\n"sv);
+        for (int i = 0; i < indent_; ++i) {
+            Write("    "sv);
+        }
     }
-}
 
-}  // namespace
+    void PrintArray(const Array& array) {
+        if (mode_ == PrintMode::PRETTY && array.empty()) {
+            Write("[]"sv);
+            return;
+        }
+        Write("["sv);
+        ++indent_;
+        bool is_first = true;
+        for (const Node& node : array) {
+            if (!is_first) {
+                Write(mode_ == PrintMode::DEFAULT ? ", "sv : ","sv);
+            }
+            is_first = false;
+            if (mode_ == PrintMode::PRETTY) {
+                NewLine();
+            }
+            PrintNode(node);
+        }
+        --indent_;
+        if (mode_ == PrintMode::PRETTY) {
+            NewLine();
+        }
+        Write(mode_ == PrintMode::DEFAULT ? "] "sv : "]"sv);
+    }
+
+    void PrintDict(const Dict& dict) {
+        if (mode_ == PrintMode::PRETTY && dict.empty()) {
+            Write("{}"sv);
+            return;
+        }
+        Write(mode_ == PrintMode::DEFAULT ? "{ "sv : "{"sv);
+        ++indent_;
+        bool is_first = true;
+        for (const auto& [key, node] : dict) {
+            if (!is_first) {
+                Write(mode_ == PrintMode::DEFAULT ? ", "sv : ","sv);
+            }
+            is_first = false;
+            if (mode_ == PrintMode::PRETTY) {
+                NewLine();
+            }
+            PrintString(key);
+            Write(mode_ == PrintMode::DEFAULT ? " : "sv : mode_ == PrintMode::PRETTY ? ": "sv : ":"sv);
+            PrintNode(node);
+        }
+        --indent_;
+        if (mode_ == PrintMode::PRETTY) {
+            NewLine();
+        }
+        Write(mode_ == PrintMode::DEFAULT ? " } "sv : "}"sv);
+    }
+};
 
 
 
@@ -425,10 +1113,14 @@ const string& Node::AsString() const {
     return get<string>(variant_);
 }
 
-const Node::Value& Node::GetValue() const {
+const Node::Value& Node::GetValue() const& {
     return variant_;
 }
 
+Node::Value&& Node::GetValue() && {
+    return move(variant_);
+}
+
 bool Node::operator==(const Node& rhs) const {
     return variant_.index() == rhs.variant_.index() && variant_ == rhs.variant_;
 }
@@ -454,88 +1146,354 @@ const Node& Document::GetRoot() const {
 }
 
 Document Load(istream& input) {
-    return Document{LoadNode(input)};
+    const string text = ReadAll(input);
+    return Load(string_view(text));
 }
 
-void PrintString(const string& str, ostream& output) {
-    const set<char> special_chars = {'\n', '\r', '\"', '\\'};
-    output << '"';
-    for (char c : str) {
-        if (c == '\n') {
-            output << '\\' << 'n';
-        } else if (c == '\r') {
-            output << '\\' << 'r';
-        } else if (c == '\t') {
-            output << c;
-        } else if (c == '\"') {
-            output << '\\' << '"';
-        } else if (c == '\\') {
-            output << '\\' << '\\';
-        } else {
-            output << c;
+Document Load(string_view text) {
+    const vector<uint32_t> index = BuildStructuralIndex(text);
+    Parser parser(text, index);
+    return Document{parser.ParseNode()};
+}
+
+FlatArray::FlatArray(const FlatNode* data, size_t size)
+    : data_(data)
+    , size_(size) {
+}
+
+const FlatNode* FlatArray::begin() const {
+    return data_;
+}
+
+const FlatNode* FlatArray::end() const {
+    return data_ + size_;
+}
+
+size_t FlatArray::size() const {
+    return size_;
+}
+
+bool FlatArray::empty() const {
+    return size_ == 0;
+}
+
+const FlatNode& FlatArray::operator[](size_t index) const {
+    return data_[index];
+}
+
+FlatDict::FlatDict(const FlatMember* data, size_t size)
+    : data_(data)
+    , size_(size) {
+}
+
+const FlatMember* FlatDict::begin() const {
+    return data_;
+}
+
+const FlatMember* FlatDict::end() const {
+    return data_ + size_;
+}
+
+size_t FlatDict::size() const {
+    return size_;
+}
+
+bool FlatDict::empty() const {
+    return size_ == 0;
+}
+
+const FlatMember* FlatDict::find(string_view key) const {
+    if (size_ <= SMALL_DICT_SIZE) {
+        for (const FlatMember& member : *this) {
+            if (member.key == key) {
+                return &member;
+            }
         }
+        return end();
     }
-   
-    output << '"';
+    const FlatMember* it = lower_bound(begin(), end(), key,
+        [] (const FlatMember& member, string_view key) {
+            return member.key < key;
+    });
+    return it != end() && it->key == key ? it : end();
+}
+
+size_t FlatDict::count(string_view key) const {
+    return find(key) != end() ? 1 : 0;
 }
 
-void PrintArray(const Node& root, ostream& output);
+const FlatNode& FlatDict::at(string_view key) const {
+    const FlatMember* it = find(key);
+    if (it == end()) {
+        throw out_of_range("key not found: " + string(key));
+    }
+    return it->value;
+}
 
-void PrintMap(const Node& root, ostream& output);
+FlatNode::FlatNode(nullptr_t) {
+}
 
+FlatNode::FlatNode(bool value)
+    : type_(Type::BOOL)
+    , bool_(value) {
+}
 
-void Print(const Document& doc, ostream& output) {
-    
-    const Node& root = move(doc.GetRoot());
+FlatNode::FlatNode(int value)
+    : type_(Type::INT)
+    , int_(value) {
+}
 
-    if (root.IsNull()) {
-        output << "null";
-    } else if (root.IsBool()) {
-        output << boolalpha << root.AsBool();
-    } else if (root.IsString()) {
-        PrintString(root.AsString(), output);
-    } else if (root.IsInt()) {
-        output << root.AsInt();
-    } else if (root.IsDouble()) {
-        output << root.AsDouble();
-    } else if (root.IsArray()) {
-        PrintArray(root, output);
-    } else if (root.IsMap()) {
-        PrintMap(root, output);
+FlatNode::FlatNode(double value)
+    : type_(Type::DOUBLE)
+    , double_(value) {
+}
+
+FlatNode::FlatNode(string_view value)
+    : type_(Type::STRING)
+    , size_(value.size())
+    , chars_(value.data()) {
+}
+
+FlatNode::FlatNode(FlatArray array)
+    : type_(Type::ARRAY)
+    , size_(array.size())
+    , items_(array.begin()) {
+}
+
+FlatNode::FlatNode(FlatDict map)
+    : type_(Type::DICT)
+    , size_(map.size())
+    , members_(map.begin()) {
+}
+
+bool FlatNode::IsInt() const {
+    return type_ == Type::INT;
+}
+bool FlatNode::IsDouble() const {
+    return type_ == Type::INT || type_ == Type::DOUBLE;
+}
+bool FlatNode::IsPureDouble() const {
+    return type_ == Type::DOUBLE;
+}
+bool FlatNode::IsBool() const {
+    return type_ == Type::BOOL;
+}
+bool FlatNode::IsString() const {
+    return type_ == Type::STRING;
+}
+bool FlatNode::IsNull() const {
+    return type_ == Type::NULL_VALUE;
+}
+bool FlatNode::IsArray() const {
+    return type_ == Type::ARRAY;
+}
+bool FlatNode::IsMap() const {
+    return type_ == Type::DICT;
+}
+
+FlatArray FlatNode::AsArray() const {
+    if (!IsArray()) {
+        throw logic_error("invalid type");
     }
+    return FlatArray(items_, size_);
 }
 
-void PrintArray(const Node& root, ostream& output) {
-    output << "[";
-    size_t counter = 0;
-    size_t n = root.AsArray().size();
-    for (const Node& node : root.AsArray()) {
-        ++counter;
-        Print(Document(node), output);
-        if (counter != n) {
-            output << ", ";
-        }
+FlatDict FlatNode::AsMap() const {
+    if (!IsMap()) {
+        throw logic_error("invalid type");
+    }
+    return FlatDict(members_, size_);
+}
+
+int FlatNode::AsInt() const {
+    if (!IsInt()) {
+        throw logic_error("invalid type");
+    }
+    return int_;
+}
+
+double FlatNode::AsDouble() const {
+    if (!IsDouble()) {
+        throw logic_error("invalid type");
     }
-    output << "] ";
+    return IsInt() ? int_ : double_;
 }
 
-void PrintMap(const Node& root, ostream& output) {
+bool FlatNode::AsBool() const {
+    if (!IsBool()) {
+        throw logic_error("invalid type");
+    }
+    return bool_;
+}
 
-    output << "{ ";
-    size_t counter = 0;
-    size_t n = root.AsMap().size();
+string_view FlatNode::AsString() const {
+    if (!IsString()) {
+        throw logic_error("invalid type");
+    }
+    return string_view(chars_, size_);
+}
+
+// Текст и арена не перемещаются вместе с документом: на них ссылаются узлы
+struct FlatDocument::Storage {
+    explicit Storage(string input)
+        : text(move(input))
+        , arena(max<size_t>(text.size(), 1 << 12)) {
+    }
     
-    for (const auto& [key, node] : root.AsMap()) {
-        ++counter;
-        PrintString(key, output);
-        output << " : ";
-        Print(Document(node), output);
-        if (counter != n) {
-            output << ", ";
+    string text;
+    pmr::monotonic_buffer_resource arena;
+};
+
+FlatDocument::FlatDocument(string text)
+    : storage_(make_unique<Storage>(move(text))) {
+    const string_view text_view = storage_->text;
+    const vector<uint32_t> index = BuildStructuralIndex(text_view);
+    FlatParser parser(text_view, index, storage_->arena);
+    root_ = parser.ParseNode();
+}
+
+FlatDocument::FlatDocument(FlatDocument&& other) = default;
+
+FlatDocument& FlatDocument::operator=(FlatDocument&& other) = default;
+
+FlatDocument::~FlatDocument() = default;
+
+const FlatNode& FlatDocument::GetRoot() const {
+    return root_;
+}
+
+FlatDocument LoadFlat(istream& input) {
+    return LoadFlat(ReadAll(input));
+}
+
+FlatDocument LoadFlat(string text) {
+    return FlatDocument(move(text));
+}
+
+void Parse(istream& input, Handler& handler) {
+    StreamParser parser(input, handler);
+    parser.ParseNode();
+}
+
+void PrintString(const string& str, ostream& output) {
+    Printer printer(output, PrintMode::DEFAULT);
+    printer.PrintString(str);
+}
+
+void Print(const Node& node, ostream& output, PrintMode mode, numbers::Format number_format) {
+    Printer printer(output, mode, number_format);
+    printer.PrintNode(node);
+}
+
+void Print(const Document& doc, ostream& output, PrintMode mode, numbers::Format number_format) {
+    Print(doc.GetRoot(), output, mode, number_format);
+}
+
+StreamWriter::StreamWriter(ostream& output, numbers::Format number_format)
+    : printer_(make_unique<Printer>(output, PrintMode::DEFAULT, number_format)) {
+}
+
+StreamWriter::~StreamWriter() = default;
+
+void StreamWriter::Flush() {
+    printer_->Flush();
+}
+
+// Законченный документ не задерживается в буфере до разрушения писателя
+void StreamWriter::EndElement() {
+    if (levels_.empty()) {
+        Flush();
+    }
+}
+
+void StreamWriter::BeginElement() {
+    if (levels_.empty()) {
+        return;
+    }
+    Level& level = levels_.back();
+    if (level.is_dict) {
+        if (!is_prev_key_) {
+            throw logic_error("expected key");
         }
+        is_prev_key_ = false;
+        return;
+    }
+    if (!level.is_empty) {
+        printer_->Write(", "sv);
     }
-    output << " } ";
+    level.is_empty = false;
 }
 
-}  // namespace json
+StreamWriter& StreamWriter::StartDict() {
+    BeginElement();
+    printer_->Write("{ "sv);
+    levels_.push_back({true});
+    return *this;
+}
+
+StreamWriter& StreamWriter::Key(const string& key) {
+    if (levels_.empty() || !levels_.back().is_dict || is_prev_key_) {
+        throw logic_error("unexpected key");
+    }
+    Level& level = levels_.back();
+    if (!level.is_empty) {
+        printer_->Write(", "sv);
+    }
+    level.is_empty = false;
+    printer_->PrintString(key);
+    printer_->Write(" : "sv);
+    is_prev_key_ = true;
+    return *this;
+}
+
+StreamWriter& StreamWriter::EndDict() {
+    if (levels_.empty() || !levels_.back().is_dict || is_prev_key_) {
+        throw logic_error("not dict");
+    }
+    levels_.pop_back();
+    printer_->Write(" } "sv);
+    EndElement();
+    return *this;
+}
 
+StreamWriter& StreamWriter::StartArray() {
+    BeginElement();
+    printer_->Write("["sv);
+    levels_.push_back({false});
+    return *this;
+}
+
+StreamWriter& StreamWriter::EndArray() {
+    if (levels_.empty() || levels_.back().is_dict) {
+        throw logic_error("not array");
+    }
+    levels_.pop_back();
+    printer_->Write("] "sv);
+    EndElement();
+    return *this;
+}
+
+StreamWriter& StreamWriter::Value(const Node& value) {
+    BeginElement();
+    printer_->PrintNode(value);
+    EndElement();
+    return *this;
+}
+
+StreamWriter& StreamWriter::RawValue(string_view json) {
+    BeginElement();
+    printer_->Write(json);
+    EndElement();
+    return *this;
+}
+
+StreamWriter& StreamWriter::RawValue(initializer_list<string_view> parts) {
+    BeginElement();
+    for (string_view part : parts) {
+        printer_->Write(part);
+    }
+    EndElement();
+    return *this;
+}
+
+}  // namespace json
@@ -1,16 +1,21 @@
 #pragma once
 
+#include "number_format.h"
+
+#include <cstdint>
+#include <initializer_list>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <set>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 
 namespace json {
 
-const std::set<char> escape_symbols = {'\n', '\t', '\r'};
-
 class Node;
 
 using Dict = std::map<std::string, Node>;
@@ -52,7 +57,10 @@ public:
     bool AsBool() const;
     const std::string& AsString() const;
     
-    const Value& GetValue() const;
+    const Value& GetValue() const&;
+    
+    // Значение временного узла можно забрать без копирования
+    Value&& GetValue() &&;
     
     bool operator==(const Node& rhs) const;
     
@@ -78,11 +86,202 @@ private:
     Node root_;
 };
 
+// Читает поток целиком и разбирает его как буфер
 Document Load(std::istream& input);
 
+Document Load(std::string_view text);
+
+// ---------- Плоское представление ------------------
+// Все узлы документа лежат в одной арене и освобождаются вместе с ним.
+// Ключи и строки без escape-последовательностей ссылаются на входной текст,
+// словари хранятся массивами пар, отсортированными по ключу
+
+class FlatNode;
+struct FlatMember;
+
+class FlatArray {
+public:
+    FlatArray() = default;
+    FlatArray(const FlatNode* data, size_t size);
+    
+    const FlatNode* begin() const;
+    const FlatNode* end() const;
+    size_t size() const;
+    bool empty() const;
+    const FlatNode& operator[](size_t index) const;
+    
+private:
+    const FlatNode* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+class FlatDict {
+public:
+    FlatDict() = default;
+    FlatDict(const FlatMember* data, size_t size);
+    
+    const FlatMember* begin() const;
+    const FlatMember* end() const;
+    size_t size() const;
+    bool empty() const;
+    
+    // end(), если ключа нет
+    const FlatMember* find(std::string_view key) const;
+    size_t count(std::string_view key) const;
+    // std::out_of_range, если ключа нет
+    const FlatNode& at(std::string_view key) const;
+    
+private:
+    const FlatMember* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+class FlatNode {
+public:
+    FlatNode() = default;
+    FlatNode(nullptr_t);
+    FlatNode(bool value);
+    FlatNode(int value);
+    FlatNode(double value);
+    FlatNode(std::string_view value);
+    FlatNode(FlatArray array);
+    FlatNode(FlatDict map);
+    
+    bool IsInt() const;
+    bool IsDouble() const;
+    bool IsPureDouble() const;
+    bool IsBool() const;
+    bool IsString() const;
+    bool IsNull() const;
+    bool IsArray() const;
+    bool IsMap() const;
+    
+    FlatArray AsArray() const;
+    FlatDict AsMap() const;
+    double AsDouble() const;
+    int AsInt() const;
+    bool AsBool() const;
+    std::string_view AsString() const;
+    
+private:
+    enum class Type : uint8_t {
+        NULL_VALUE,
+        BOOL,
+        INT,
+        DOUBLE,
+        STRING,
+        ARRAY,
+        DICT,
+    };
+    
+    Type type_ = Type::NULL_VALUE;
+    uint32_t size_ = 0;
+    union {
+        bool bool_;
+        int int_;
+        double double_ = 0;
+        const char* chars_;
+        const FlatNode* items_;
+        const FlatMember* members_;
+    };
+};
+
+struct FlatMember {
+    std::string_view key;
+    FlatNode value;
+};
+
+class FlatDocument {
+public:
+    FlatDocument(FlatDocument&& other);
+    FlatDocument& operator=(FlatDocument&& other);
+    ~FlatDocument();
+    
+    const FlatNode& GetRoot() const;
+    
+private:
+    struct Storage;
+    
+    std::unique_ptr<Storage> storage_;
+    FlatNode root_;
+    
+    explicit FlatDocument(std::string text);
+    
+    friend FlatDocument LoadFlat(std::string text);
+};
+
+FlatDocument LoadFlat(std::istream& input);
+
+FlatDocument LoadFlat(std::string text);
+
+// Получатель событий потокового разбора
+class Handler {
+public:
+    virtual void StartDict() = 0;
+    virtual void Key(std::string key) = 0;
+    virtual void EndDict() = 0;
+    virtual void StartArray() = 0;
+    virtual void EndArray() = 0;
+    // Строка, число, bool или null
+    virtual void Value(Node::Value value) = 0;
+
+protected:
+    ~Handler() = default;
+};
+
+// Разбирает поток по частям, не собирая документ в памяти
+void Parse(std::istream& input, Handler& handler);
+
 void PrintString(const std::string& str, std::ostream& output);
 
-void Print(const Document& doc, std::ostream& output);
+// DEFAULT - "[a, b] ", "{ "k" : v } ", COMPACT - без пробелов, PRETTY - по элементу на строке с отступами
+enum class PrintMode {
+    DEFAULT,
+    COMPACT,
+    PRETTY,
+};
+
+// number_format - вывод вещественных чисел, целые выводятся как есть
+void Print(const Node& node, std::ostream& output, PrintMode mode = PrintMode::DEFAULT, numbers::Format number_format = {});
+
+void Print(const Document& doc, std::ostream& output, PrintMode mode = PrintMode::DEFAULT, numbers::Format number_format = {});
+
+class Printer;
+
+// Выводит документ по частям в том же формате, что и Print, через один буфер на все время
+// жизни. Буфер сбрасывается в поток, когда заполнится, закончится документ или по Flush.
+// Ключи словаря пишутся в порядке вызовов Key
+class StreamWriter {
+public:
+    explicit StreamWriter(std::ostream& output, numbers::Format number_format = {});
+    ~StreamWriter();
+    
+    StreamWriter& StartDict();
+    StreamWriter& Key(const std::string& key);
+    StreamWriter& EndDict();
+    StreamWriter& StartArray();
+    StreamWriter& EndArray();
+    StreamWriter& Value(const Node& value);
+    // Уже готовый JSON, например строка с кавычками и экранированием
+    StreamWriter& RawValue(std::string_view json);
+    // Готовый JSON из нескольких частей подряд, например длинная строка без склейки
+    StreamWriter& RawValue(std::initializer_list<std::string_view> parts);
+    
+    void Flush();
+    
+private:
+    struct Level {
+        bool is_dict = false;
+        bool is_empty = true;
+    };
+    
+    std::unique_ptr<Printer> printer_;
+    std::vector<Level> levels_;
+    bool is_prev_key_ = false;
+    
+    void BeginElement();
+    void EndElement();
+};
 
 }  // namespace json
 
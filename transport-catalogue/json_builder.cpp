@@ -9,6 +9,11 @@ StartDictContext KeyContext::Value(const Node::Value& value) {
     return StartDictContext(builder_);
 }
 
+StartDictContext KeyContext::Value(Node::Value&& value) {
+    builder_.Value(move(value));
+    return StartDictContext(builder_);
+}
+
 StartArrayContext KeyContext::StartArray() {
     builder_.StartArray();
     return StartArrayContext(builder_);
@@ -19,8 +24,8 @@ StartDictContext KeyContext::StartDict() {
     return StartDictContext(builder_);
 }
 
-KeyContext StartDictContext::Key(const string& key) {
-    builder_.Key(key);
+KeyContext StartDictContext::Key(string key) {
+    builder_.Key(move(key));
     return KeyContext(builder_);
 }
 
@@ -33,6 +38,11 @@ StartArrayContext StartArrayContext::Value(const Node::Value& value) {
     return StartArrayContext(builder_);
 }
 
+StartArrayContext StartArrayContext::Value(Node::Value&& value) {
+    builder_.Value(move(value));
+    return StartArrayContext(builder_);
+}
+
 StartArrayContext StartArrayContext::StartArray() {
     builder_.StartArray();
     return StartArrayContext(builder_);
@@ -48,7 +58,7 @@ Builder& StartArrayContext::EndArray() {
 }
 
 
-KeyContext Builder::Key(const string& key) {
+KeyContext Builder::Key(string key) {
     if (is_built_) {
         throw logic_error("expected building");
     }
@@ -60,30 +70,34 @@ KeyContext Builder::Key(const string& key) {
         throw logic_error("not a dict");
     }
     is_prev_key = true;
-    keys_.push(key);
+    keys_.push(move(key));
     return KeyContext(*this);
 }
 
 Builder& Builder::Value(const Node::Value& value) {
+    return Value(Node::Value(value));
+}
+
+Builder& Builder::Value(Node::Value&& value) {
     if (is_built_) {
         throw logic_error("expected building");
     }
     
     is_prev_key = false;
     if (included_values_.empty()) {
-        value_ = value;
+        value_ = move(value);
         is_built_ = true;
         return *this;
     }
     if (holds_alternative<Array> (included_values_.top())) {
-        (get<Array> (included_values_.top())).push_back(Node(value));
+        (get<Array> (included_values_.top())).emplace_back(move(value));
         return *this;
     }
     if (holds_alternative<Dict> (included_values_.top())) {
         if (keys_.empty()) {
             throw logic_error("expected key");
         }
-        (get<Dict> (included_values_.top()))[keys_.top()] = Node(value);
+        (get<Dict> (included_values_.top())).insert_or_assign(move(keys_.top()), Node(move(value)));
         keys_.pop();
         is_prev_key = false;
         return *this;
@@ -111,10 +125,10 @@ Builder& Builder::EndDict() {
     if (is_prev_key) {
         throw logic_error("expected value");
     }
-    Node::Value dict = included_values_.top();
+    Node::Value dict = move(included_values_.top());
     included_values_.pop();
     is_prev_key = false;
-    return Value(dict);
+    return Value(move(dict));
 }
 
 Builder& Builder::EndArray() {
@@ -124,20 +138,24 @@ Builder& Builder::EndArray() {
     if (included_values_.empty() || !holds_alternative<Array> (included_values_.top())) {
         throw logic_error("not array");
     }
-    Node::Value array = included_values_.top();
+    Node::Value array = move(included_values_.top());
     included_values_.pop();
     is_prev_key = false;
-    return Value(array);
+    return Value(move(array));
 }
 
 Node Builder::Build() {
+    if (is_value_taken_) {
+        throw logic_error("value has already been taken");
+    }
     if (is_built_) {
-        return Node(value_);
+        is_value_taken_ = true;
+        return Node(move(value_));
     }
     throw logic_error("has not built yet");
 }
 
-void Builder::PushEmptyArrayOrDict(const Node::Value& value) {
+void Builder::PushEmptyArrayOrDict(Node::Value value) {
     if (is_built_) {
         throw logic_error("expected building");
     }
@@ -145,7 +163,7 @@ void Builder::PushEmptyArrayOrDict(const Node::Value& value) {
         throw logic_error("invalid command");
     }
     is_prev_key = false;
-    included_values_.push(value);
+    included_values_.push(move(value));
 }
 
 } // namespace json
@@ -14,10 +14,12 @@ class StartArrayContext;
 class Builder {
 public:
     
-    KeyContext Key(const std::string& key);
+    KeyContext Key(std::string key);
     
     Builder& Value(const Node::Value& value);
     
+    Builder& Value(Node::Value&& value);
+    
     StartDictContext StartDict();
     
     StartArrayContext StartArray();
@@ -26,6 +28,7 @@ public:
     
     Builder& EndArray();
     
+    // Забирает собранное значение: повторный вызов бросает logic_error
     Node Build();
     
 private:
@@ -33,9 +36,10 @@ private:
     std::stack<std::string> keys_;
     bool is_prev_key = false;
     bool is_built_ = false;
+    bool is_value_taken_ = false;
     std::stack<Node::Value> included_values_;
     
-    void PushEmptyArrayOrDict(const Node::Value& value);
+    void PushEmptyArrayOrDict(Node::Value value);
 };
 
 class Context {
@@ -54,6 +58,8 @@ public:
     
     StartDictContext Value(const Node::Value& value);
     
+    StartDictContext Value(Node::Value&& value);
+    
     StartArrayContext StartArray();
     
     StartDictContext StartDict();
@@ -64,7 +70,7 @@ public:
     StartDictContext(Builder& builder) : Context(builder) {
     }
     
-    KeyContext Key(const std::string& key);
+    KeyContext Key(std::string key);
     
     Builder& EndDict();
 };
@@ -76,6 +82,8 @@ public:
     
     StartArrayContext Value(const Node::Value& value);
     
+    StartArrayContext Value(Node::Value&& value);
+    
     StartArrayContext StartArray();
     
     StartDictContext StartDict();
@@ -1,4 +1,5 @@
 #include "json_reader.h"
+#include "requests.h"
 #include "serialization.h"
 
 #include <optional>
@@ -18,94 +19,174 @@ namespace json_reader {
 
 void ProcessRequests(istream& input, ostream& output) {
     
-    const json::Document requests = Load(input);
+    // Запросы только читаются, поэтому разбираются в плоский документ с общей ареной
+    const json::FlatDocument requests = LoadFlat(input);
     
-    ifstream in(requests.GetRoot().AsMap().at("serialization_settings").AsMap().at("file").AsString());
+    serialization::Deserializer base(string(requests.GetRoot().AsMap().at("serialization_settings").AsMap().at("file").AsString()));
     
-    serialization::TransportCatalogue transport_catalogue_serialized;
-    transport_catalogue_serialized.ParseFromIstream(&in);
+    request_handler::RequestHandler request_handler(base);
     
-    transport_catalogue::TransportCatalogue transport_catalogue(transport_catalogue_serialized);
+    ProcessStatRequests(requests.GetRoot().AsMap().at("stat_requests").AsArray(), request_handler, output,
+                        ReadOutputNumberFormat(requests.GetRoot().AsMap()));
     
-    serialization::RenderSettings render_settings;
-    renderer::MapRenderer map_renderer(transport_catalogue_serialized.render_settings());
+}
+
+numbers::Format ReadOutputNumberFormat(const FlatDict& requests) {
+    numbers::Format result;
+    if (!requests.count("output_settings") || !requests.at("output_settings").AsMap().count("json_precision")) {
+        return result;
+    }
+    result.decimals = requests.at("output_settings").AsMap().at("json_precision").AsInt();
+    if (result.decimals < 0) {
+        throw invalid_argument("invalid json_precision");
+    }
+    return result;
+}
+
+void ProcessStatRequests(FlatArray stat_requests, const RequestHandler& request_handler, ostream& output, numbers::Format number_format) {
     
-    transport_catalogue::TransportRouter router(transport_catalogue_serialized, transport_catalogue);
-           
-    request_handler::RequestHandler request_handler(transport_catalogue, map_renderer, router);
+    // Ответы выводятся по мере вычисления, массив целиком не собирается
+    json::StreamWriter writer(output, number_format);
+    writer.StartArray();
     
-    ProcessStatRequests(requests.GetRoot().AsMap().at("stat_requests").AsArray(), request_handler, output);
+    for (const FlatNode& request_node : stat_requests) {
+        WriteStatResponse(request_node, request_handler, writer);
+    }
     
+    writer.EndArray();
 }
 
+void ProcessStatRequestsNdjson(istream& input, const RequestHandler& request_handler, ostream& output) {
+    
+    string line;
+    while (getline(input, line)) {
+        if (line.find_first_not_of(" \t\r") == string::npos) {
+            continue;
+        }
+        try {
+            const json::FlatDocument request = LoadFlat(move(line));
+            json::StreamWriter writer(output);
+            WriteStatResponse(request.GetRoot(), request_handler, writer);
+        } catch (const exception& e) {
+            // Ответ на испорченную строку - ошибка, остальные запросы обрабатываются дальше
+            Print(json::Builder{}.StartDict().Key("error_message").Value(e.what()).EndDict().Build(), output);
+        }
+        output << '\n';
+        // Пока следующий запрос не пришел, ответы не задерживаются в буфере
+        if (input.rdbuf()->in_avail() <= 0) {
+            output.flush();
+        }
+    }
+}
+
+namespace {
 
-void ProcessStatRequests(const vector<Node>& stat_requests, const RequestHandler& request_handler, ostream& output) {
+void AddStopResponse(const requests::StopRequest& request, const RequestHandler& request_handler, json::StartDictContext& context) {
+    optional<vector<string>> buses_for_stop = request_handler.ProcessStopRequest(string(request.name));
+    if (buses_for_stop) {
+        vector<Node> bus_nodes(buses_for_stop.value().size());
+        transform(buses_for_stop.value().begin(), buses_for_stop.value().end(), bus_nodes.begin(),
+            [] (string& busname) {
+                return Node(move(busname));
+        });
+        context.Key("buses").Value(move(bus_nodes));
+    } else {
+        context.Key("error_message").Value("not found");
+    }
+}
+
+void AddBusResponse(const requests::BusRequest& request, const RequestHandler& request_handler, json::StartDictContext& context) {
+    optional<request_handler::BusRequestResult> result = request_handler.ProcessBusRequest(string(request.name));
+    if (result) {
+        context.Key("route_length"s).Value((int) result->route_length);
+        context.Key("stop_count"s).Value((int) result->stop_count);
+        context.Key("curvature").Value(result->curvature);
+        context.Key("unique_stop_count").Value((int) result->unique_stop_count);
+    } else {
+        context.Key("error_message"s).Value("not found"s);
+    }
+}
+
+// Полную карту выводит WriteStatResponse из кеша, сюда попадают только части карты
+void AddMapResponse(const requests::MapRequest& request, const RequestHandler& request_handler, json::StartDictContext& context) {
+    if (!request.bbox) {
+        throw logic_error("full map response is written by WriteStatResponse");
+    }
+    context.Key("map").Value(request_handler.RenderMap(*request.bbox, request.width, request.height));
+}
+
+void AddRouteResponse(const requests::RouteRequest& request, const RequestHandler& request_handler, json::StartDictContext& context) {
+    auto route = request_handler.BuildRoute(request.from, request.to);
+    if (route) {
+        context.Key("total_time").Value(route->weight);
+        vector<Node> items = CalcRouteItems(route->edges, request_handler.GetRouter().GetGraph(), request_handler.GetRouter().GetIdToVertex());
+        context.Key("items").Value(move(items));
+    } else {
+        context.Key("error_message").Value("not found");
+    }
+}
+
+Node BuildStatResponse(const requests::StatRequest& request, const RequestHandler& request_handler) {
     
     json::Builder builder;
-    json::StartArrayContext context = builder.StartArray();
+    json::StartDictContext context = builder.StartDict().Key("request_id").Value(request.id);
     
-    for (const Node& request_node : stat_requests) {
-        int id = request_node.AsMap().at("id").AsInt();
-        const string type = request_node.AsMap().at("type").AsString();
-        json::StartDictContext context_second = context.StartDict().Key("request_id").Value(id);
-        
-        if (type == "Stop") {
-            
-            string stopname = request_node.AsMap().at("name").AsString();
-            optional<vector<string>> buses_for_stop = request_handler.ProcessStopRequest(stopname);
-            if (buses_for_stop) {
-                vector<Node> bus_nodes(buses_for_stop.value().size());
-                transform(buses_for_stop.value().begin(), buses_for_stop.value().end(), bus_nodes.begin(),
-                    [] (const string& busname) {
-                        return Node(busname);
-                });
-                context_second.Key("buses").Value(move(bus_nodes));
-                
-            } else {
-                context_second.Key("error_message").Value("not found");
-            }
-            
-        } else if (type == "Bus") {
-            
-            string name = request_node.AsMap().at("name").AsString();
-            optional<request_handler::BusRequestResult> result = request_handler.ProcessBusRequest(name);
-            if (result) {
-                context_second.Key("route_length"s).Value((int) result->route_length);
-                context_second.Key("stop_count"s).Value((int) result->stop_count);
-                context_second.Key("curvature").Value(result->curvature);
-                context_second.Key("unique_stop_count").Value((int) result->unique_stop_count);
-            } else {
-                context_second.Key("error_message"s).Value("not found"s);
-            }
-            
-        } else if (type == "Map") {
-            
-            const svg::Document doc = request_handler.RenderMap();
-            ostringstream stream;
-            doc.Render(stream);
-            context_second.Key("map").Value(stream.str()); 
-            
-        } else if (type == "Route") {
-            
-            string from = request_node.AsMap().at("from").AsString();
-            string to = request_node.AsMap().at("to").AsString();
-            
-            auto route = request_handler.BuildRoute(from, to);
-            if (route) {
-                context_second.Key("total_time").Value(route->weight);
-                vector<Node> items = CalcRouteItems(route->edges, request_handler.GetRouter().GetGraph(), request_handler.GetRouter().GetIdToVertex());
-                context_second.Key("items").Value(items);
-            } else {
-                context_second.Key("error_message").Value("not found");
-            }
-            
-        }
-        context_second.EndDict();
+    switch (request.type) {
+        case requests::StatRequestType::STOP:
+            AddStopResponse(get<requests::StopRequest>(request.data), request_handler, context);
+            break;
+        case requests::StatRequestType::BUS:
+            AddBusResponse(get<requests::BusRequest>(request.data), request_handler, context);
+            break;
+        case requests::StatRequestType::MAP:
+            AddMapResponse(get<requests::MapRequest>(request.data), request_handler, context);
+            break;
+        case requests::StatRequestType::ROUTE:
+            AddRouteResponse(get<requests::RouteRequest>(request.data), request_handler, context);
+            break;
+        case requests::StatRequestType::ROUTE_MAP:
+            throw logic_error("RouteMap response is written by WriteStatResponse");
+        case requests::StatRequestType::UNKNOWN:
+            break;
     }
+    context.EndDict();
     
-    context.EndArray();
+    return builder.Build();
+}
+
+} // namespace
 
-    Print(json::Document(builder.Build()), output);
+void WriteStatResponse(const FlatNode& request_node, const RequestHandler& request_handler, json::StreamWriter& writer) {
+    
+    const requests::StatRequest request = requests::DecodeStatRequest(request_node);
+    
+    if (request.type == requests::StatRequestType::MAP && !get<requests::MapRequest>(request.data).bbox) {
+        // Ключи в том порядке, в котором их вывел бы словарь
+        const string& map_json = request_handler.GetMapJson();
+        writer.StartDict().Key("map").RawValue(map_json).Key("request_id").Value(request.id).EndDict();
+        return;
+    }
+    if (request.type == requests::StatRequestType::ROUTE_MAP) {
+        const requests::RouteMapRequest& route_map = get<requests::RouteMapRequest>(request.data);
+        const auto route = request_handler.BuildRoute(route_map.from, route_map.to);
+        if (!route) {
+            writer.StartDict().Key("error_message").Value("not found"s).Key("request_id").Value(request.id).EndDict();
+            return;
+        }
+        // Все, что может бросить исключение, считается до начала вывода ответа
+        const Node items(CalcRouteItems(route->edges, request_handler.GetRouter().GetGraph(), request_handler.GetRouter().GetIdToVertex()));
+        const request_handler::RouteMapJson map_json = request_handler.GetRouteMapJson(*route);
+        
+        // Карта не попадает в json::Node: готовые части строки выводятся как есть
+        writer.StartDict()
+            .Key("items").Value(items)
+            .Key("map").RawValue({map_json.map_begin, map_json.overlay, map_json.map_end})
+            .Key("request_id").Value(request.id)
+            .Key("total_time").Value(route->weight)
+            .EndDict();
+        return;
+    }
+    writer.Value(BuildStatResponse(request, request_handler));
 }
 
 vector<Node> CalcRouteItems(const vector<EdgeId>& edges, const DirectedWeightedGraph<double>& graph, const vector<TransportRouter::Vertex>& id_to_vertex) {
@@ -124,7 +205,7 @@ vector<Node> CalcRouteItems(const vector<EdgeId>& edges, const DirectedWeightedG
             res["span_count"s] = Node((int) edge.stop_count);
             res["bus"s] = Node(edge.busname);
         }
-        result.push_back(res);
+        result.push_back(move(res));
     }
     return result;
 }
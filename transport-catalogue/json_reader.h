@@ -19,7 +19,18 @@ namespace json_reader {
     
     void ProcessRequests(std::istream& input, std::ostream& output = std::cout);
 
-    void ProcessStatRequests(const std::vector<Node>& stat_requests, const RequestHandler& request_handler, std::ostream& output = std::cout);
+    // Вывод вещественных чисел ответов: output_settings.json_precision документа запросов
+    numbers::Format ReadOutputNumberFormat(const json::FlatDict& requests);
+
+    void ProcessStatRequests(json::FlatArray stat_requests, const RequestHandler& request_handler, std::ostream& output = std::cout,
+                             numbers::Format number_format = {});
+
+    // Запросы - по одному JSON-объекту в строке, ответы выводятся так же, по мере вычисления.
+    // В памяти одновременно только текущий запрос
+    void ProcessStatRequestsNdjson(std::istream& input, const RequestHandler& request_handler, std::ostream& output = std::cout);
+
+    // Ответ выводится сразу в writer, карта берется из кеша обработчика запросов
+    void WriteStatResponse(const json::FlatNode& request_node, const RequestHandler& request_handler, json::StreamWriter& writer);
 
     std::vector<json::Node> CalcRouteItems(const std::vector<graph::EdgeId>& edges, const graph::DirectedWeightedGraph<double>& graph, const std::vector<TransportRouter::Vertex>& id_to_vertex);
 
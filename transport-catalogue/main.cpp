@@ -1,5 +1,6 @@
 #include "json_reader.h"
 #include "serialization.h"
+#include "server.h"
 
 #include <iostream>
 #include <cassert>
@@ -10,18 +11,49 @@ using namespace std;
 using namespace std::literals;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv
+           << "       transport_catalogue process_requests_ndjson <base_file>\n"sv
+           << "       transport_catalogue serve <base_file> [socket_path]\n"sv;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
+    if (argc < 2) {
         PrintUsage();
         return 1;
     }
 
     const std::string_view mode(argv[1]);
     
-    if (mode == "make_base"sv) {
+    if (mode == "process_requests_ndjson"sv) {
+        if (argc != 3) {
+            PrintUsage();
+            return 1;
+        }
+        
+        // Свой буфер у cin нужен, чтобы видеть, есть ли уже прочитанные запросы
+        std::ios::sync_with_stdio(false);
+        serialization::Deserializer base(argv[2]);
+        request_handler::RequestHandler request_handler(base);
+        json_reader::ProcessStatRequestsNdjson(cin, request_handler, cout);
+        
+    } else if (mode == "serve"sv) {
+        if (argc != 3 && argc != 4) {
+            PrintUsage();
+            return 1;
+        }
+        
+        server::Server server(argv[2]);
+        if (argc == 4) {
+            server.ServeSocket(argv[3]);
+        } else {
+            server.ServeStdio();
+        }
+        
+    } else if (argc != 2) {
+        PrintUsage();
+        return 1;
+        
+    } else if (mode == "make_base"sv) {
         
         serialization::Serializer serializer;
         serializer.SerializeFromInput(cin);
@@ -1,5 +1,11 @@
 #include "map_renderer.h"
 
+#include <cmath>
+#include <functional>
+#include <future>
+#include <limits>
+#include <thread>
+
 using namespace domain;
 using namespace renderer;
 using namespace svg;
@@ -8,10 +14,317 @@ using namespace geo;
 
 namespace renderer {
 
+namespace {
+
+// Карта, в которой меньше стольких точек и остановок, рисуется в одном потоке:
+// запуск потоков обходится дороже самой отрисовки
+constexpr size_t PARALLEL_MIN_POINTS = 1 << 12;
+
+} // namespace
+
 bool IsZero(double value) {
     return std::abs(value) < EPSILON;
 }
 
+double GetZoomLevelTolerance(int level) {
+    return 360.0 / (256.0 * static_cast<double>(1 << level));
+}
+
+int SelectZoomLevel(double pixel_size) {
+    int level = 0;
+    while (level <= MAX_ZOOM_LEVEL && !(GetZoomLevelTolerance(level) <= pixel_size)) {
+        ++level;
+    }
+    return level;
+}
+
+namespace {
+
+// Расстояние от точки до отрезка в градусах: проекция карты одинаково масштабирует обе оси
+double ComputePlaneDistance(Coordinates point, Coordinates from, Coordinates to) {
+    const double d_lng = to.lng - from.lng;
+    const double d_lat = to.lat - from.lat;
+    const double length_sq = d_lng * d_lng + d_lat * d_lat;
+    double t = 0;
+    if (length_sq > 0) {
+        t = clamp(((point.lng - from.lng) * d_lng + (point.lat - from.lat) * d_lat) / length_sq, 0.0, 1.0);
+    }
+    return hypot(point.lng - (from.lng + t * d_lng), point.lat - (from.lat + t * d_lat));
+}
+
+} // namespace
+
+vector<uint8_t> ComputeZoomLevels(const vector<Coordinates>& points) {
+    vector<uint8_t> levels(points.size(), 0);
+    if (points.size() < 3) {
+        return levels;
+    }
+    
+    // Значимость точки - ее отклонение при разбиении Дугласа-Пекера, но не больше значимости
+    // разбившей интервал точки: тогда набор точек уровня z вложен в набор уровня z + 1
+    struct Range {
+        size_t first;
+        size_t last;
+        double significance;
+    };
+    vector<Range> ranges = {{0, points.size() - 1, numeric_limits<double>::infinity()}};
+    while (!ranges.empty()) {
+        const Range range = ranges.back();
+        ranges.pop_back();
+        if (range.last - range.first < 2) {
+            continue;
+        }
+        size_t farthest = range.first + 1;
+        double max_distance = -1;
+        for (size_t i = range.first + 1; i < range.last; ++i) {
+            const double distance = ComputePlaneDistance(points[i], points[range.first], points[range.last]);
+            if (distance > max_distance) {
+                max_distance = distance;
+                farthest = i;
+            }
+        }
+        const double significance = min(max_distance, range.significance);
+        
+        int level = 0;
+        while (level <= MAX_ZOOM_LEVEL && GetZoomLevelTolerance(level) > significance) {
+            ++level;
+        }
+        levels[farthest] = static_cast<uint8_t>(level);
+        ranges.push_back({range.first, farthest, significance});
+        ranges.push_back({farthest, range.last, significance});
+    }
+    return levels;
+}
+
+namespace {
+
+// Доли отрезка from-to, лежащие внутри прямоугольника (алгоритм Лианга-Барски).
+// nullopt - отрезок целиком снаружи
+optional<pair<double, double>> ClipSegment(Coordinates from, Coordinates to, const BoundingBox& bbox) {
+    const double d_lng = to.lng - from.lng;
+    const double d_lat = to.lat - from.lat;
+    // Каждая граница задает условие p * t <= q
+    const pair<double, double> bounds[] = {
+        {-d_lng, from.lng - bbox.min.lng},
+        {d_lng, bbox.max.lng - from.lng},
+        {-d_lat, from.lat - bbox.min.lat},
+        {d_lat, bbox.max.lat - from.lat},
+    };
+    double t_begin = 0;
+    double t_end = 1;
+    for (const auto& [p, q] : bounds) {
+        if (p == 0) {
+            if (q < 0) {
+                return nullopt;
+            }
+            continue;
+        }
+        const double t = q / p;
+        if (p < 0) {
+            t_begin = max(t_begin, t);
+        } else {
+            t_end = min(t_end, t);
+        }
+        if (t_begin > t_end) {
+            return nullopt;
+        }
+    }
+    return pair{t_begin, t_end};
+}
+
+// Концы необрезанного отрезка берутся как есть, без погрешности вычислений
+Coordinates Interpolate(Coordinates from, Coordinates to, double t) {
+    if (t == 0) {
+        return from;
+    }
+    if (t == 1) {
+        return to;
+    }
+    return {from.lat + (to.lat - from.lat) * t, from.lng + (to.lng - from.lng) * t};
+}
+
+} // namespace
+
+StopProjection::StopProjection(const vector<StopPtr>& stops, double max_width, double max_height, double padding) {
+    vector<Coordinates> coordinates;
+    coordinates.reserve(stops.size());
+    size_t table_size = 0;
+    for (const StopPtr& stop : stops) {
+        coordinates.push_back(stop->coordinates);
+        table_size = max(table_size, stop->id + 1);
+    }
+    const SphereProjector projector(coordinates.begin(), coordinates.end(), max_width, max_height, padding);
+    
+    points_.resize(table_size);
+    for (const StopPtr& stop : stops) {
+        points_[stop->id] = projector(stop->coordinates);
+    }
+}
+
+vector<size_t> ComputeColorIndices(const vector<const Bus*>& buses) {
+    size_t table_size = 0;
+    for (const Bus* bus : buses) {
+        table_size = max(table_size, bus->id + 1);
+    }
+    vector<size_t> result(table_size);
+    size_t color_index = 0;
+    for (const Bus* bus : buses) {
+        result[bus->id] = color_index;
+        if (!bus->stops.empty()) {
+            ++color_index;
+        }
+    }
+    return result;
+}
+
+MapIndex::MapIndex(vector<BusPtr> buses, vector<StopPtr> stops)
+    : buses_(move(buses))
+    , stops_(move(stops))
+    , color_indices_(ComputeColorIndices(buses_)) {
+    
+    if (stops_.empty()) {
+        return;
+    }
+    bounds_ = {stops_[0]->coordinates, stops_[0]->coordinates};
+    for (const StopPtr& stop : stops_) {
+        bounds_.min.lat = min(bounds_.min.lat, stop->coordinates.lat);
+        bounds_.min.lng = min(bounds_.min.lng, stop->coordinates.lng);
+        bounds_.max.lat = max(bounds_.max.lat, stop->coordinates.lat);
+        bounds_.max.lng = max(bounds_.max.lng, stop->coordinates.lng);
+    }
+    
+    // Около одной остановки на ячейку
+    const size_t side = max<size_t>(1, static_cast<size_t>(sqrt(static_cast<double>(stops_.size()))));
+    if (!IsZero(bounds_.max.lng - bounds_.min.lng)) {
+        columns_ = side;
+        cell_lng_ = (bounds_.max.lng - bounds_.min.lng) / columns_;
+    }
+    if (!IsZero(bounds_.max.lat - bounds_.min.lat)) {
+        rows_ = side;
+        cell_lat_ = (bounds_.max.lat - bounds_.min.lat) / rows_;
+    }
+    cell_stops_.resize(columns_ * rows_);
+    cell_segments_.resize(columns_ * rows_);
+    
+    for (size_t i = 0; i < stops_.size(); ++i) {
+        const Coordinates& coordinates = stops_[i]->coordinates;
+        cell_stops_[GetRow(coordinates.lat) * columns_ + GetColumn(coordinates.lng)].push_back(static_cast<uint32_t>(i));
+    }
+    
+    for (size_t bus = 0; bus < buses_.size(); ++bus) {
+        const vector<StopPtr>& route = buses_[bus]->stops;
+        for (size_t i = 0; i < route.size() && (i == 0 || i + 1 < route.size()); ++i) {
+            AddSegment(route[i]->coordinates, route[min(i + 1, route.size() - 1)]->coordinates,
+                       {static_cast<uint32_t>(bus), static_cast<uint32_t>(i)});
+        }
+    }
+}
+
+// Отрезок попадает только в ячейки, которые пересекает (обход сетки Амантидеса-Ву),
+// а не во все ячейки своих габаритов: длинный диагональный перегон иначе занял бы всю сетку
+void MapIndex::AddSegment(Coordinates from, Coordinates to, Segment segment) {
+    size_t column = GetColumn(from.lng);
+    size_t row = GetRow(from.lat);
+    const size_t last_column = GetColumn(to.lng);
+    const size_t last_row = GetRow(to.lat);
+    
+    // Координаты в единицах ячеек
+    const double x = columns_ == 1 ? 0 : (from.lng - bounds_.min.lng) / cell_lng_;
+    const double y = rows_ == 1 ? 0 : (from.lat - bounds_.min.lat) / cell_lat_;
+    const double dx = columns_ == 1 ? 0 : (to.lng - from.lng) / cell_lng_;
+    const double dy = rows_ == 1 ? 0 : (to.lat - from.lat) / cell_lat_;
+    
+    // Ровно столько шагов, сколько границ ячеек между концами: обход всегда заканчивается в ячейке конца
+    cell_segments_[row * columns_ + column].push_back(segment);
+    while (column != last_column || row != last_row) {
+        bool is_column_step = row == last_row;
+        if (column != last_column && row != last_row) {
+            // Доля отрезка до ближайшей границы по каждой оси
+            const double t_x = (static_cast<double>(column + (dx > 0 ? 1 : 0)) - x) / dx;
+            const double t_y = (static_cast<double>(row + (dy > 0 ? 1 : 0)) - y) / dy;
+            is_column_step = t_x < t_y;
+        }
+        if (is_column_step) {
+            column = column < last_column ? column + 1 : column - 1;
+        } else {
+            row = row < last_row ? row + 1 : row - 1;
+        }
+        cell_segments_[row * columns_ + column].push_back(segment);
+    }
+}
+
+const vector<MapIndex::BusPtr>& MapIndex::GetBuses() const {
+    return buses_;
+}
+
+const vector<MapIndex::StopPtr>& MapIndex::GetStops() const {
+    return stops_;
+}
+
+size_t MapIndex::GetColorIndex(size_t bus) const {
+    return color_indices_[buses_[bus]->id];
+}
+
+vector<size_t> MapIndex::FindStops(const BoundingBox& bbox) const {
+    vector<size_t> result;
+    const optional<CellRange> range = GetCellRange(bbox);
+    if (!range) {
+        return result;
+    }
+    for (size_t row = range->first_row; row <= range->last_row; ++row) {
+        for (size_t column = range->first_column; column <= range->last_column; ++column) {
+            for (uint32_t stop : cell_stops_[row * columns_ + column]) {
+                if (bbox.Contains(stops_[stop]->coordinates)) {
+                    result.push_back(stop);
+                }
+            }
+        }
+    }
+    sort(result.begin(), result.end());
+    return result;
+}
+
+vector<MapIndex::Segment> MapIndex::FindSegments(const BoundingBox& bbox) const {
+    vector<Segment> result;
+    const optional<CellRange> range = GetCellRange(bbox);
+    if (!range) {
+        return result;
+    }
+    for (size_t row = range->first_row; row <= range->last_row; ++row) {
+        for (size_t column = range->first_column; column <= range->last_column; ++column) {
+            const vector<Segment>& cell = cell_segments_[row * columns_ + column];
+            result.insert(result.end(), cell.begin(), cell.end());
+        }
+    }
+    // Длинный отрезок лежит в нескольких ячейках
+    sort(result.begin(), result.end());
+    result.erase(unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+optional<MapIndex::CellRange> MapIndex::GetCellRange(const BoundingBox& bbox) const {
+    if (cell_stops_.empty()
+        || bbox.max.lat < bounds_.min.lat || bbox.min.lat > bounds_.max.lat
+        || bbox.max.lng < bounds_.min.lng || bbox.min.lng > bounds_.max.lng) {
+        return nullopt;
+    }
+    return CellRange{GetColumn(bbox.min.lng), GetColumn(bbox.max.lng), GetRow(bbox.min.lat), GetRow(bbox.max.lat)};
+}
+
+size_t MapIndex::GetColumn(double lng) const {
+    if (columns_ == 1 || lng <= bounds_.min.lng) {
+        return 0;
+    }
+    return min(columns_ - 1, static_cast<size_t>((lng - bounds_.min.lng) / cell_lng_));
+}
+
+size_t MapIndex::GetRow(double lat) const {
+    if (rows_ == 1 || lat <= bounds_.min.lat) {
+        return 0;
+    }
+    return min(rows_ - 1, static_cast<size_t>((lat - bounds_.min.lat) / cell_lat_));
+}
+
 MapRenderer::MapRenderer(const renderer::RenderSettings& render_settings)
     : render_settings_(render_settings) {
 }
@@ -34,6 +347,10 @@ MapRenderer::MapRenderer(const serialization::RenderSettings& render_settings) {
     for (size_t i = 0; i < render_settings.color_palette_size(); ++i) {
         render_settings_.color_palette.push_back(ReadSerializedColor(render_settings.color_palette(i)));
     }
+    
+    if (render_settings.has_svg_number_format()) {
+        render_settings_.number_format.decimals = render_settings.svg_number_format().decimals();
+    }
 }
                                                  
 svg::Color MapRenderer::ReadSerializedColor(const serialization::Color& color) {
@@ -52,160 +369,362 @@ svg::Color MapRenderer::ReadSerializedColor(const serialization::Color& color) {
     return Rgba(red, green, blue, opasity);
 }
                                                  
-svg::Document MapRenderer::Render(const vector<BusPtr>& buses, const vector<StopPtr>& stops) const {
+StopProjection MapRenderer::ProjectStops(const vector<StopPtr>& stops) const {
+    return StopProjection(stops, render_settings_.width, render_settings_.height, render_settings_.padding);
+}
+
+string MapRenderer::Render(const StopProjection& projection, const vector<BusPtr>& buses, const vector<StopPtr>& stops) const {
+    
+    size_t point_count = stops.size();
+    for (const BusPtr& bus : buses) {
+        point_count += bus->stops.size();
+    }
     
-    vector<Coordinates> all_stop_coords;
-    CalcAllStopsCoordinates(buses, all_stop_coords);
-    SphereProjector projector(all_stop_coords.begin(), all_stop_coords.end(), render_settings_.width,
-                              render_settings_.height, render_settings_.padding);
+    // Слои независимы: каждый пишется в свой буфер, буферы склеиваются в порядке слоев
+    const function<void(svg::Writer&)> layers[] = {
+        [&](svg::Writer& writer) { RenderRoutes(buses, projection, writer); },
+        [&](svg::Writer& writer) { RenderRouteNames(buses, projection, writer); },
+        [&](svg::Writer& writer) { RenderStops(stops, projection, writer); },
+        [&](svg::Writer& writer) { RenderStopNames(stops, projection, writer); },
+    };
     
-    svg::Document doc;
-    RenderRoutes(buses, projector, doc);
-    RenderRouteNames(buses, projector, doc);
-    RenderStops(stops, projector, doc);
-    RenderStopNames(stops, projector, doc);
-    return doc;
+    svg::Writer writer(render_settings_.number_format);
+    writer.StartDocument();
+    if (point_count < PARALLEL_MIN_POINTS || thread::hardware_concurrency() < 2) {
+        for (const auto& layer : layers) {
+            layer(writer);
+        }
+    } else {
+        vector<future<string>> texts;
+        for (auto it = next(begin(layers)); it != end(layers); ++it) {
+            texts.push_back(async(launch::async, [this, &layer = *it] {
+                svg::Writer layer_writer(render_settings_.number_format);
+                layer(layer_writer);
+                return layer_writer.ExtractText();
+            }));
+        }
+        // Первый слой - в основной буфер, пока остальные рисуются в своих потоках
+        layers[0](writer);
+        for (future<string>& text : texts) {
+            writer.Write(text.get());
+        }
+    }
+    writer.EndDocument();
+    return writer.ExtractText();
+}
+
+string MapRenderer::RenderRouteOverlay(const StopProjection& projection, const vector<RouteRide>& rides) const {
+    
+    size_t palette_colors_count = render_settings_.color_palette.size();
+    
+    // Поездка выделяется подложкой под линией маршрута
+    Polyline substrate = MakeRouteLine();
+    substrate.SetStrokeColor(render_settings_.underlayer_color);
+    substrate.SetStrokeWidth(render_settings_.line_width + render_settings_.underlayer_width);
+    Polyline route = MakeRouteLine();
+    
+    svg::Writer writer(render_settings_.number_format);
+    // Высадка и следующая за ней посадка - одна остановка пересадки
+    vector<StopPtr> transfers;
+    for (const RouteRide& ride : rides) {
+        substrate.ClearPoints();
+        route.ClearPoints();
+        route.SetStrokeColor(render_settings_.color_palette[ride.color_index % palette_colors_count]);
+        for (const StopPtr& stop : ride.stops) {
+            substrate.AddPoint(projection(stop));
+            route.AddPoint(projection(stop));
+        }
+        writer.Add(substrate);
+        writer.Add(route);
+        
+        if (transfers.empty() || transfers.back() != ride.stops.front()) {
+            transfers.push_back(ride.stops.front());
+        }
+        transfers.push_back(ride.stops.back());
+    }
+    
+    Circle circle;
+    circle.SetRadius(2 * render_settings_.stop_radius);
+    circle.SetFillColor("white");
+    circle.SetStrokeColor("black");
+    circle.SetStrokeWidth(render_settings_.stop_radius / 2);
+    for (const StopPtr& stop : transfers) {
+        circle.SetCenter(projection(stop));
+        writer.Add(circle);
+    }
+    RenderStopNames(transfers, projection, writer);
+    return writer.ExtractText();
+}
+
+string MapRenderer::RenderViewport(const MapIndex& index, const BoundingBox& bbox, double width, double height) const {
+    
+    const Coordinates corners[] = {bbox.min, bbox.max};
+    SphereProjector projector(begin(corners), end(corners), width, height, render_settings_.padding);
+    
+    const vector<MapIndex::Segment> segments = index.FindSegments(bbox);
+    const int zoom_level = SelectZoomLevel(projector.GetPixelSize());
+    vector<StopPtr> stops;
+    for (size_t stop : index.FindStops(bbox)) {
+        stops.push_back(index.GetStops()[stop]);
+    }
+    
+    svg::Writer writer(render_settings_.number_format);
+    writer.StartDocument(width, height);
+    RenderClippedRoutes(index, segments, bbox, zoom_level, projector, writer);
+    RenderViewportRouteNames(index, segments, bbox, projector, writer);
+    const auto project = [&projector](StopPtr stop) {
+        return projector(stop->coordinates);
+    };
+    RenderStops(stops, project, writer);
+    RenderStopNames(stops, project, writer);
+    writer.EndDocument();
+    return writer.ExtractText();
 }
                                                  
                                                  
 
 
-void MapRenderer::RenderRoutes(const vector<BusPtr>& buses, const SphereProjector& projector, svg::Document& doc) const {
+void MapRenderer::RenderRoutes(const vector<BusPtr>& buses, const StopProjection& projection, svg::Writer& writer) const {
     
     size_t palette_colors_count = render_settings_.color_palette.size();
     size_t color_counter = 0;
+    
+    // Одна ломаная на все маршруты: меняются только цвет и точки
+    Polyline route = MakeRouteLine();
     for (const auto& bus : buses) {
-        Polyline route;
-        route.SetFillColor(NoneColor);
-        route.SetStrokeWidth(render_settings_.line_width);
-        route.SetStrokeLineCap(StrokeLineCap::ROUND);
-        route.SetStrokeLineJoin(StrokeLineJoin::ROUND);
         route.SetStrokeColor(render_settings_.color_palette[color_counter]);
         if (!(bus->stops).empty()) {
             color_counter = (color_counter + 1) % palette_colors_count;
         }
-        RenderOneRoute(bus->stops, projector, route, bus->is_roundtrip);
-        doc.Add(route);
+        route.ClearPoints();
+        RenderOneRoute(bus->stops, projection, route, bus->is_roundtrip);
+        writer.Add(route);
+    }
+}
+
+// Видимые части маршрута - отдельные ломаные. Обратный ход маршрута не из кольца
+// проходит по тем же отрезкам, поэтому рисуется только прямой
+void MapRenderer::RenderClippedRoutes(const MapIndex& index, const vector<MapIndex::Segment>& segments, const BoundingBox& bbox,
+                                      int zoom_level, const SphereProjector& projector, svg::Writer& writer) const {
+    
+    size_t palette_colors_count = render_settings_.color_palette.size();
+    
+    Polyline route = MakeRouteLine();
+    bool has_points = false;
+    // Последняя точка ломаной - необрезанный конец предыдущего отрезка, остановка previous_end
+    bool is_open = false;
+    bool has_previous = false;
+    uint32_t previous_bus = 0;
+    size_t previous_end = 0;
+    for (const MapIndex::Segment& segment : segments) {
+        const BusPtr bus = index.GetBuses()[segment.bus];
+        if (bus->stops.size() < 2) {
+            continue;
+        }
+        // Несколько исходных отрезков попадают в один отрезок упрощенной линии
+        if (has_previous && previous_bus == segment.bus && segment.index < previous_end) {
+            continue;
+        }
+        const auto [first, last] = GetSimplifiedSegment(bus, segment.index, zoom_level);
+        const Coordinates& from = bus->stops[first]->coordinates;
+        const Coordinates& to = bus->stops[last]->coordinates;
+        const auto clipped = ClipSegment(from, to, bbox);
+        const bool is_continued = is_open && previous_bus == segment.bus && previous_end == first
+            && clipped && clipped->first == 0;
+        has_previous = true;
+        previous_bus = segment.bus;
+        previous_end = last;
+        if (!clipped) {
+            is_open = false;
+            continue;
+        }
+        
+        if (!is_continued) {
+            if (has_points) {
+                writer.Add(route);
+            }
+            route.ClearPoints();
+            route.SetStrokeColor(render_settings_.color_palette[index.GetColorIndex(segment.bus) % palette_colors_count]);
+            route.AddPoint(projector(Interpolate(from, to, clipped->first)));
+            has_points = true;
+        }
+        route.AddPoint(projector(Interpolate(from, to, clipped->second)));
+        is_open = clipped->second == 1;
+    }
+    if (has_points) {
+        writer.Add(route);
+    }
+}
+
+pair<size_t, size_t> MapRenderer::GetSimplifiedSegment(BusPtr bus, size_t index, int zoom_level) {
+    const vector<uint8_t>& levels = bus->stop_zoom_levels;
+    if (levels.size() != bus->stops.size()) {
+        return {index, index + 1};
+    }
+    // Концы маршрута нужны на любом уровне, поэтому оба поиска останавливаются
+    size_t first = index;
+    while (levels[first] > zoom_level) {
+        --first;
     }
+    size_t last = index + 1;
+    while (levels[last] > zoom_level) {
+        ++last;
+    }
+    return {first, last};
 }
 
-void MapRenderer::RenderOneRoute(const vector<StopPtr>& stops, const SphereProjector& projector,
+void MapRenderer::RenderOneRoute(const vector<StopPtr>& stops, const StopProjection& projection,
                                  Polyline& route, bool is_roundtrip) const {
     
-    vector<Point> points;
-    points.reserve(stops.size());
     for (const auto& stop : stops) {
-        Point point = projector(stop->coordinates);
-        route.AddPoint(point);
-        points.push_back(point);
+        route.AddPoint(projection(stop));
     }
-    if (is_roundtrip) {
+    if (is_roundtrip || stops.empty()) {
         return;
     }
     
-    points.pop_back();
-    reverse(points.begin(), points.end());
-    for (const Point& point : points) {
-        route.AddPoint(point);
+    // Обратный путь - те же остановки в обратном порядке без конечной
+    for (auto it = next(stops.rbegin()); it != stops.rend(); ++it) {
+        route.AddPoint(projection(*it));
     }
 }
 
-void MapRenderer::RenderRouteNames(const vector<BusPtr>& buses, const SphereProjector& projector, svg::Document& doc) const {
+void MapRenderer::RenderRouteNames(const vector<BusPtr>& buses, const StopProjection& projection, svg::Writer& writer) const {
     
     size_t palette_colors_count = render_settings_.color_palette.size();
     size_t color_counter = 0;
     
+    Text text;
+    Text substrate;
+    SetBusLabelStyle(text, substrate);
+    
     for (const BusPtr& bus : buses) {
         if (bus->stops.empty()) {
             continue;
         }
-        Text substrate;
-        substrate.SetPosition(projector(bus->stops[0]->coordinates));
-        substrate.SetOffset(render_settings_.bus_label_offset);
-        substrate.SetFontSize((int) render_settings_.bus_label_font_size);
-        const string font_family = "Verdana";
-        substrate.SetFontFamily(font_family);
-        const string font_weight = "bold";
-        substrate.SetFontWeight(font_weight);
+        substrate.SetPosition(projection(bus->stops[0]));
         substrate.SetData(bus->name);
-        
-        Text text = substrate;
-        
-        substrate.SetFillColor(render_settings_.underlayer_color);
-        substrate.SetStrokeColor(render_settings_.underlayer_color);
-        substrate.SetStrokeWidth(render_settings_.underlayer_width);
-        substrate.SetStrokeLineCap(StrokeLineCap::ROUND);
-        substrate.SetStrokeLineJoin(StrokeLineJoin::ROUND);
-        
-        doc.Add(substrate);
-        
+        text.SetPosition(projection(bus->stops[0]));
+        text.SetData(bus->name);
         text.SetFillColor(render_settings_.color_palette[color_counter]);
         color_counter = (color_counter + 1) % palette_colors_count;
         
-        doc.Add(text);
+        writer.Add(substrate);
+        writer.Add(text);
         
         if (!bus->is_roundtrip && bus->stops[0] != bus->stops.back()) {
-            substrate.SetPosition(projector(bus->stops.back()->coordinates));
-            text.SetPosition(projector(bus->stops.back()->coordinates));
-            doc.Add(substrate);
-            doc.Add(text);
+            substrate.SetPosition(projection(bus->stops.back()));
+            text.SetPosition(projection(bus->stops.back()));
+            writer.Add(substrate);
+            writer.Add(text);
         }
     }
 }
 
-void MapRenderer::RenderStops(const vector<StopPtr>& stops, const SphereProjector& projector, svg::Document& doc) const {
+// Подпись маршрута видна, если его конечная внутри прямоугольника. Такая конечная -
+// конец первого или последнего отрезка, поэтому маршрут есть среди найденных отрезков
+void MapRenderer::RenderViewportRouteNames(const MapIndex& index, const vector<MapIndex::Segment>& segments,
+                                           const BoundingBox& bbox, const SphereProjector& projector, svg::Writer& writer) const {
+    
+    size_t palette_colors_count = render_settings_.color_palette.size();
+    
+    Text text;
+    Text substrate;
+    SetBusLabelStyle(text, substrate);
     
+    for (auto it = segments.begin(); it != segments.end(); ) {
+        const uint32_t bus_index = it->bus;
+        it = find_if(it, segments.end(), [bus_index](const MapIndex::Segment& segment) {
+            return segment.bus != bus_index;
+        });
+        
+        const BusPtr bus = index.GetBuses()[bus_index];
+        substrate.SetData(bus->name);
+        text.SetData(bus->name);
+        text.SetFillColor(render_settings_.color_palette[index.GetColorIndex(bus_index) % palette_colors_count]);
+        
+        vector<StopPtr> terminals = {bus->stops[0]};
+        if (!bus->is_roundtrip && bus->stops[0] != bus->stops.back()) {
+            terminals.push_back(bus->stops.back());
+        }
+        for (const StopPtr& terminal : terminals) {
+            if (!bbox.Contains(terminal->coordinates)) {
+                continue;
+            }
+            substrate.SetPosition(projector(terminal->coordinates));
+            text.SetPosition(projector(terminal->coordinates));
+            writer.Add(substrate);
+            writer.Add(text);
+        }
+    }
+}
+
+template <typename Projection>
+void MapRenderer::RenderStops(const vector<StopPtr>& stops, const Projection& project, svg::Writer& writer) const {
+    
+    Circle circle;
+    circle.SetRadius(render_settings_.stop_radius);
+    circle.SetFillColor("white");
     for (const StopPtr& stop : stops) {
-        Circle circle;
-        circle.SetCenter(projector(stop->coordinates));
-        circle.SetRadius(render_settings_.stop_radius);
-        const Color color = "white";
-        circle.SetFillColor(color);
-        doc.Add(circle);
+        circle.SetCenter(project(stop));
+        writer.Add(circle);
     }
 }
 
-void MapRenderer::RenderStopNames(const vector<StopPtr>& stops, const SphereProjector& projector, svg::Document& doc) const {
+template <typename Projection>
+void MapRenderer::RenderStopNames(const vector<StopPtr>& stops, const Projection& project, svg::Writer& writer) const {
+    
+    Text text;
+    text.SetOffset(render_settings_.stop_label_offset);
+    text.SetFontSize(render_settings_.stop_label_font_size);
+    text.SetFontFamily("Verdana");
+    
+    Text substrate = text;
+    substrate.SetFillColor(render_settings_.underlayer_color);
+    substrate.SetStrokeColor(render_settings_.underlayer_color);
+    substrate.SetStrokeWidth(render_settings_.underlayer_width);
+    substrate.SetStrokeLineCap(StrokeLineCap::ROUND);
+    substrate.SetStrokeLineJoin(StrokeLineJoin::ROUND);
+    
+    text.SetFillColor("black");
     
     for (const StopPtr& stop : stops) {
-        Text substrate;
-        substrate.SetPosition(projector(stop->coordinates));
-        substrate.SetOffset(render_settings_.stop_label_offset);
-        substrate.SetFontSize(render_settings_.stop_label_font_size);
-        const string font_family = "Verdana";
-        substrate.SetFontFamily(font_family);
+        const Point position = project(stop);
+        substrate.SetPosition(position);
         substrate.SetData(stop->name);
+        text.SetPosition(position);
+        text.SetData(stop->name);
         
-        Text text = substrate;
-        
-        substrate.SetFillColor(render_settings_.underlayer_color);
-        substrate.SetStrokeColor(render_settings_.underlayer_color);
-        substrate.SetStrokeWidth(render_settings_.underlayer_width);
-        substrate.SetStrokeLineCap(StrokeLineCap::ROUND);
-        substrate.SetStrokeLineJoin(StrokeLineJoin::ROUND);
-        
-        doc.Add(substrate);
-        
-        const Color color = "black";
-        
-        text.SetFillColor(color);
-                          
-        doc.Add(text);
-        
+        writer.Add(substrate);
+        writer.Add(text);
     }
 }
 
-void MapRenderer::SetRenderSettings(const RenderSettings& render_settings) {
-    render_settings_ = render_settings;
+Polyline MapRenderer::MakeRouteLine() const {
+    Polyline route;
+    route.SetFillColor(NoneColor);
+    route.SetStrokeWidth(render_settings_.line_width);
+    route.SetStrokeLineCap(StrokeLineCap::ROUND);
+    route.SetStrokeLineJoin(StrokeLineJoin::ROUND);
+    return route;
 }
 
-void MapRenderer::CalcAllStopsCoordinates(const vector<BusPtr>& buses, vector<Coordinates>& all_stops_coords) const {
+void MapRenderer::SetBusLabelStyle(Text& text, Text& substrate) const {
+    text.SetOffset(render_settings_.bus_label_offset);
+    text.SetFontSize((int) render_settings_.bus_label_font_size);
+    text.SetFontFamily("Verdana");
+    text.SetFontWeight("bold");
     
-    for (const auto& bus : buses) {
-        for (const auto& stop : bus->stops) {
-            all_stops_coords.push_back(stop->coordinates);
-        }
-    }
+    substrate = text;
+    substrate.SetFillColor(render_settings_.underlayer_color);
+    substrate.SetStrokeColor(render_settings_.underlayer_color);
+    substrate.SetStrokeWidth(render_settings_.underlayer_width);
+    substrate.SetStrokeLineCap(StrokeLineCap::ROUND);
+    substrate.SetStrokeLineJoin(StrokeLineJoin::ROUND);
+}
+
+void MapRenderer::SetRenderSettings(const RenderSettings& render_settings) {
+    render_settings_ = render_settings;
 }
 
 } // namespace renderer
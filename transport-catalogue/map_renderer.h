@@ -6,9 +6,11 @@
 #include "serialization.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <optional>
+#include <string>
 #include <vector>
 
 using RenderSettingsSerialized = serialization::RenderSettings;
@@ -17,6 +19,7 @@ using ColorSerialized = serialization::Color;
 namespace renderer {
 
 class MapRenderer;
+class MapIndex;
 struct RenderSettings;
 class SphereProjector;
 
@@ -24,6 +27,18 @@ class SphereProjector;
 inline const double EPSILON = 1e-6;
 bool IsZero(double value);
 
+// Уровни масштаба как у веб-карт: на уровне z пиксель - 360 / (256 * 2^z) градусов
+inline const int MAX_ZOOM_LEVEL = 20;
+double GetZoomLevelTolerance(int level);
+
+// Самый грубый уровень, упрощение на котором не заметно при данном размере пикселя.
+// MAX_ZOOM_LEVEL + 1 - пиксель меньше любого уровня, упрощать нельзя
+int SelectZoomLevel(double pixel_size);
+
+// Для каждой точки ломаной - наименьший уровень, на котором ее нельзя выбросить: без нее ломаная
+// отклонится от исходной больше чем на пиксель уровня (Дуглас-Пекер). Концы нужны на любом уровне
+std::vector<uint8_t> ComputeZoomLevels(const std::vector<geo::Coordinates>& points);
+
 
 class SphereProjector {
 public:
@@ -39,6 +54,11 @@ public:
             (max_lat_ - coords.lat) * zoom_coeff_ + padding_
         };
     }
+    
+    // Размер пикселя в градусах, 0 - масштаб не определен
+    double GetPixelSize() const {
+        return IsZero(zoom_coeff_) ? 0 : 1 / zoom_coeff_;
+    }
 
 private:
     double padding_;
@@ -48,6 +68,39 @@ private:
 };
 
 
+/*
+ * Точки остановок на полной карте. Проектор строится по остановкам один раз,
+ * каждая остановка проецируется один раз, дальше точки берутся из таблицы по id
+ */
+class StopProjection {
+public:
+    using StopPtr = const domain::Stop*;
+    
+    // stops - остановки, через которые проходят маршруты
+    StopProjection(const std::vector<StopPtr>& stops, double max_width, double max_height, double padding);
+    
+    svg::Point operator()(StopPtr stop) const {
+        return points_[stop->id];
+    }
+    
+private:
+    std::vector<svg::Point> points_;
+};
+
+
+// Поездка найденного маршрута на одном автобусе: остановки в порядке проезда
+struct RouteRide {
+    const domain::Bus* bus;
+    // Номер цвета автобуса на полной карте
+    size_t color_index;
+    std::vector<const domain::Stop*> stops;
+};
+
+// Номер цвета каждого автобуса на полной карте, по id автобуса. Цвета палитры по очереди
+// получают непустые маршруты buses, как при отрисовке карты
+std::vector<size_t> ComputeColorIndices(const std::vector<const domain::Bus*>& buses);
+
+
 struct RenderSettings {
     double width;
     double height;
@@ -61,6 +114,75 @@ struct RenderSettings {
     svg::Color underlayer_color;
     double underlayer_width;
     std::vector<svg::Color> color_palette;
+    // Вывод чисел SVG, по умолчанию - 6 значащих цифр
+    numbers::Format number_format;
+};
+
+
+/*
+ * Равномерная сетка над остановками сети. В ячейке - остановки и отрезки маршрутов,
+ * чьи габариты ее задевают, поэтому выборка по прямоугольнику не перебирает всю сеть
+ */
+class MapIndex {
+public:
+    using BusPtr = const domain::Bus*;
+    using StopPtr = const domain::Stop*;
+    
+    // Отрезок маршрута buses[bus] между остановками index и index + 1.
+    // У маршрута из одной остановки единственный отрезок вырожден в точку
+    struct Segment {
+        uint32_t bus;
+        uint32_t index;
+        
+        bool operator<(const Segment& other) const {
+            return bus < other.bus || (bus == other.bus && index < other.index);
+        }
+        bool operator==(const Segment& other) const {
+            return bus == other.bus && index == other.index;
+        }
+    };
+    
+    // Автобусы и остановки - в порядке отрисовки полной карты
+    MapIndex(std::vector<BusPtr> buses, std::vector<StopPtr> stops);
+    
+    const std::vector<BusPtr>& GetBuses() const;
+    const std::vector<StopPtr>& GetStops() const;
+    
+    // Номер маршрута среди непустых: по нему выбирается цвет, как на полной карте
+    size_t GetColorIndex(size_t bus) const;
+    
+    // Номера остановок внутри прямоугольника, по возрастанию
+    std::vector<size_t> FindStops(const geo::BoundingBox& bbox) const;
+    
+    // Отрезки, чьи габариты пересекают прямоугольник, по возрастанию
+    std::vector<Segment> FindSegments(const geo::BoundingBox& bbox) const;
+    
+private:
+    std::vector<BusPtr> buses_;
+    std::vector<StopPtr> stops_;
+    // По id автобуса
+    std::vector<size_t> color_indices_;
+    
+    geo::BoundingBox bounds_;
+    size_t columns_ = 1;
+    size_t rows_ = 1;
+    double cell_lat_ = 0;
+    double cell_lng_ = 0;
+    std::vector<std::vector<uint32_t>> cell_stops_;
+    std::vector<std::vector<Segment>> cell_segments_;
+    
+    struct CellRange {
+        size_t first_column;
+        size_t last_column;
+        size_t first_row;
+        size_t last_row;
+    };
+    
+    // nullopt - прямоугольник целиком вне сетки
+    std::optional<CellRange> GetCellRange(const geo::BoundingBox& bbox) const;
+    void AddSegment(geo::Coordinates from, geo::Coordinates to, Segment segment);
+    size_t GetColumn(double lng) const;
+    size_t GetRow(double lat) const;
 };
 
 
@@ -73,24 +195,52 @@ public:
     MapRenderer(const renderer::RenderSettings& render_settings);
     MapRenderer(const serialization::RenderSettings& render_settings);
     
-    svg::Document Render(const std::vector<BusPtr>& buses, const std::vector<StopPtr>& stops) const;
+    // Точки остановок stops на полной карте с размерами из настроек
+    StopProjection ProjectStops(const std::vector<StopPtr>& stops) const;
+    
+    // Текст SVG-документа: элементы пишутся сразу в буфер, без промежуточного svg::Document.
+    // На большой сети четыре слоя карты рисуются параллельно. projection - точки остановок stops
+    std::string Render(const StopProjection& projection, const std::vector<BusPtr>& buses,
+                       const std::vector<StopPtr>& stops) const;
+    
+    // Слой поверх полной карты: поездки маршрута и остановки посадки и высадки с подписями.
+    // Только элементы, без заголовка и закрывающего тега документа
+    std::string RenderRouteOverlay(const StopProjection& projection, const std::vector<RouteRide>& rides) const;
+    
+    // Часть карты внутри bbox, вписанная в изображение width x height. Ломаные обрезаются
+    // по границе прямоугольника, остановки и подписи рисуются только попавшие внутрь
+    std::string RenderViewport(const MapIndex& index, const geo::BoundingBox& bbox, double width, double height) const;
     
     void SetRenderSettings(const RenderSettings& render_settings);
     
 private:
     RenderSettings render_settings_;
     
-    void CalcAllStopsCoordinates(const std::vector<BusPtr>& buses, std::vector<geo::Coordinates>& all_stop_coords) const;
+    void RenderRoutes(const std::vector<BusPtr>& buses, const StopProjection& projection, svg::Writer& writer) const;
+    
+    void RenderOneRoute(const std::vector<StopPtr>& stops, const StopProjection& projection, svg::Polyline& route, bool is_roundtrip) const;
+    
+    void RenderRouteNames(const std::vector<BusPtr>& buses, const StopProjection& projection, svg::Writer& writer) const;
+    
+    // project - точка остановки: StopProjection на полной карте, проектор на части карты
+    template <typename Projection>
+    void RenderStops(const std::vector<StopPtr>& stops, const Projection& project, svg::Writer& writer) const;
+    
+    template <typename Projection>
+    void RenderStopNames(const std::vector<StopPtr>& stops, const Projection& project, svg::Writer& writer) const;
     
-    void RenderRoutes(const std::vector<BusPtr>& buses, const SphereProjector& projector, svg::Document& doc) const;
+    void RenderClippedRoutes(const MapIndex& index, const std::vector<MapIndex::Segment>& segments, const geo::BoundingBox& bbox,
+                             int zoom_level, const SphereProjector& projector, svg::Writer& writer) const;
     
-    void RenderOneRoute(const std::vector<StopPtr>& stops, const SphereProjector& projector, svg::Polyline& route, bool is_roundtrip) const;
+    // Концы отрезка упрощенной линии маршрута, содержащего исходный отрезок index..index+1
+    static std::pair<size_t, size_t> GetSimplifiedSegment(BusPtr bus, size_t index, int zoom_level);
     
-    void RenderRouteNames(const std::vector<BusPtr>& buses, const SphereProjector& projector, svg::Document& doc) const;
+    void RenderViewportRouteNames(const MapIndex& index, const std::vector<MapIndex::Segment>& segments,
+                                  const geo::BoundingBox& bbox, const SphereProjector& projector, svg::Writer& writer) const;
     
-    void RenderStops(const std::vector<StopPtr>& stops, const SphereProjector& projector, svg::Document& doc) const;
+    svg::Polyline MakeRouteLine() const;
     
-    void RenderStopNames(const std::vector<StopPtr>& stops, const SphereProjector& projector, svg::Document& doc) const;
+    void SetBusLabelStyle(svg::Text& text, svg::Text& substrate) const;
     
     static svg::Color ReadSerializedColor(const serialization::Color& color);
 };
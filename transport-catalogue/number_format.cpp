@@ -0,0 +1,46 @@
+#include "number_format.h"
+
+#include <charconv>
+#include <system_error>
+
+using namespace std;
+
+namespace numbers {
+
+namespace {
+
+// "1.500" -> "1.5", "2.00" -> "2", "-0.00" -> "0"
+char* TrimFraction(char* first, char* last) {
+    char* point = first;
+    while (point != last && *point != '.') {
+        ++point;
+    }
+    if (point != last) {
+        while (last[-1] == '0') {
+            --last;
+        }
+        if (last[-1] == '.') {
+            --last;
+        }
+    }
+    if (last - first == 2 && first[0] == '-' && first[1] == '0') {
+        first[0] = '0';
+        --last;
+    }
+    return last;
+}
+
+} // namespace
+
+char* ToChars(double value, Format format, char* first) {
+    char* const last = first + MAX_LENGTH;
+    if (format.decimals >= 0) {
+        const auto result = to_chars(first, last, value, chars_format::fixed, format.decimals);
+        if (result.ec == errc{}) {
+            return TrimFraction(first, result.ptr);
+        }
+    }
+    return to_chars(first, last, value, chars_format::general, 6).ptr;
+}
+
+} // namespace numbers
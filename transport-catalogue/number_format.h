@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+namespace numbers {
+
+// Формат вещественных чисел при выводе
+struct Format {
+    // Знаков после точки, хвостовые нули отбрасываются. Отрицательное - как ostream
+    // по умолчанию: 6 значащих цифр
+    int decimals = -1;
+};
+
+// Размер буфера, в который помещается любое число
+inline constexpr size_t MAX_LENGTH = 32;
+
+// Пишет value в буфер из MAX_LENGTH символов с начала first, возвращает конец записи.
+// Число, не помещающееся в буфер с фиксированной точкой, пишется как по умолчанию
+char* ToChars(double value, Format format, char* first);
+
+} // namespace numbers
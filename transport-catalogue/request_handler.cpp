@@ -1,59 +1,184 @@
 #include "request_handler.h"
+#include "json.h"
+
+#include <sstream>
+#include <stdexcept>
 
 using namespace std;
 using namespace request_handler;
 using namespace transport_catalogue;
 
+namespace {
+
+// Остановки автобуса bus от from до to через span_count перегонов. Некольцевой
+// маршрут проезжается и в обратную сторону
+vector<StopPtr> FindRideStops(BusPtr bus, StopPtr from, StopPtr to, size_t span_count) {
+    const vector<StopPtr>& stops = bus->stops;
+    for (size_t i = 0; i + span_count < stops.size(); ++i) {
+        if (stops[i] == from && stops[i + span_count] == to) {
+            return {stops.begin() + i, stops.begin() + i + span_count + 1};
+        }
+    }
+    if (!bus->is_roundtrip) {
+        for (size_t i = span_count; i < stops.size(); ++i) {
+            if (stops[i] == from && stops[i - span_count] == to) {
+                return {make_reverse_iterator(stops.begin() + i + 1), make_reverse_iterator(stops.begin() + i - span_count)};
+            }
+        }
+    }
+    throw logic_error("ride is not on the route of bus " + bus->name);
+}
+
+// Закрывающий тег, которым кончается текст карты
+string GetMapEnd() {
+    svg::Writer writer;
+    writer.EndDocument();
+    return writer.ExtractText();
+}
+
+} // namespace
+
 RequestHandler::RequestHandler(const TransportCatalogue& db, const MapRenderer& renderer, const TransportRouter& router)
-    : db_(db), renderer_(renderer), router_(router) {
+    : db_(&db), renderer_(&renderer), router_(&router) {
+}
+
+RequestHandler::RequestHandler(const serialization::Deserializer& base)
+    : base_(&base) {
 }
 
 std::optional<graph::Router<double>::RouteInfo> RequestHandler::BuildRoute(string_view from, string_view to) const {
-    return router_.BuildRoute(from, to);
+    return GetRouter().BuildRoute(from, to);
 }
 
 const TransportRouter& RequestHandler::GetRouter() const {
-    return router_;
+    if (!router_) {
+        loaded_router_ = make_unique<TransportRouter>(base_->GetRouterGraph(), base_->GetRoutesTable());
+        router_ = loaded_router_.get();
+    }
+    return *router_;
+}
+
+const TransportCatalogue& RequestHandler::GetCatalogue() const {
+    if (!db_) {
+        loaded_db_ = make_unique<TransportCatalogue>(base_->GetTransportCatalogue());
+        db_ = loaded_db_.get();
+    }
+    return *db_;
+}
+
+const MapRenderer& RequestHandler::GetRenderer() const {
+    if (!renderer_) {
+        loaded_renderer_ = make_unique<MapRenderer>(base_->GetRenderSettings());
+        renderer_ = loaded_renderer_.get();
+    }
+    return *renderer_;
 }
 
 BusPtr RequestHandler::GetBus(string_view bus_name) const {
-    return db_.GetBus(bus_name);
+    return GetCatalogue().GetBus(bus_name);
 }
 
 vector<BusPtr> RequestHandler::GetAllBuses() const {
-    return db_.GetAllBuses();
+    return GetCatalogue().GetAllBuses();
 }
 
 vector<StopPtr> RequestHandler::GetAllStops() const {
-    return db_.GetAllStops();
+    return GetCatalogue().GetAllStops();
 }
 
 vector<StopPtr> RequestHandler::GetAllNonEmptyStops() const {
-    return db_.GetAllNonEmptyStops();
+    return GetCatalogue().GetAllNonEmptyStops();
 }
 
 pair<int, int> RequestHandler::GetWaitTimeAndVelocity() const {
-    return db_.GetWaitTimeAndVelocity();
+    return GetCatalogue().GetWaitTimeAndVelocity();
 }
 
 const unordered_set<BusPtr> RequestHandler::GetBusesForStop(string_view stop_name) const {
-    return db_.GetBusesForStop(stop_name);
+    return GetCatalogue().GetBusesForStop(stop_name);
 }
 
 bool RequestHandler::IsThereBus(string_view bus_name) const {
-    return db_.IsThereBus(bus_name);
+    return GetCatalogue().IsThereBus(bus_name);
 }
 
 bool RequestHandler::IsThereStop(string_view stop_name) const {
-    return db_.IsThereStop(stop_name);
+    return GetCatalogue().IsThereStop(stop_name);
 }
 
 int RequestHandler::GetDistanceBetweenStops(string_view from, string_view to) const {
-    return db_.GetDistanceBetweenStops(from, to);
+    return GetCatalogue().GetDistanceBetweenStops(from, to);
+}
+
+string RequestHandler::RenderMap() const {
+    return GetRenderer().Render(GetStopProjection(), GetAllBuses(), GetAllNonEmptyStops());
+}
+
+string RequestHandler::RenderMap(const geo::BoundingBox& bbox, double width, double height) const {
+    return GetRenderer().RenderViewport(GetMapIndex(), bbox, width, height);
+}
+
+const renderer::StopProjection& RequestHandler::GetStopProjection() const {
+    if (!stop_projection_) {
+        stop_projection_ = make_unique<renderer::StopProjection>(GetRenderer().ProjectStops(GetAllNonEmptyStops()));
+    }
+    return *stop_projection_;
+}
+
+const renderer::MapIndex& RequestHandler::GetMapIndex() const {
+    if (!map_index_) {
+        map_index_ = make_unique<renderer::MapIndex>(GetAllBuses(), GetAllNonEmptyStops());
+    }
+    return *map_index_;
+}
+
+const string& RequestHandler::GetMapJson() const {
+    if (!map_json_) {
+        ostringstream json;
+        json::PrintString(RenderMap(), json);
+        map_json_ = json.str();
+        
+        // Без открывающей кавычки
+        ostringstream end_json;
+        json::PrintString(GetMapEnd(), end_json);
+        map_json_end_ = end_json.str().substr(1);
+    }
+    return *map_json_;
+}
+
+RouteMapJson RequestHandler::GetRouteMapJson(const graph::Router<double>::RouteInfo& route) const {
+    const string_view map_json = GetMapJson();
+    ostringstream overlay_json;
+    json::PrintString(RenderRouteOverlay(route), overlay_json);
+    string overlay = overlay_json.str();
+    overlay.pop_back();
+    overlay.erase(0, 1);
+    return {map_json.substr(0, map_json.size() - map_json_end_.size()), move(overlay), map_json_end_};
+}
+
+vector<renderer::RouteRide> RequestHandler::GetRouteRides(const graph::Router<double>::RouteInfo& route) const {
+    if (!color_indices_) {
+        color_indices_ = renderer::ComputeColorIndices(GetAllBuses());
+    }
+    const graph::DirectedWeightedGraph<double>& graph = GetRouter().GetGraph();
+    const vector<TransportRouter::Vertex>& id_to_vertex = GetRouter().GetIdToVertex();
+    
+    vector<renderer::RouteRide> rides;
+    for (graph::EdgeId edge_id : route.edges) {
+        const graph::Edge<double>& edge = graph.GetEdge(edge_id);
+        if (edge.stop_count == 0) {
+            continue;
+        }
+        const BusPtr bus = GetBus(edge.busname);
+        const StopPtr from = GetCatalogue().GetStop(id_to_vertex[edge.from].stopname);
+        const StopPtr to = GetCatalogue().GetStop(id_to_vertex[edge.to].stopname);
+        rides.push_back({bus, (*color_indices_)[bus->id], FindRideStops(bus, from, to, edge.stop_count)});
+    }
+    return rides;
 }
 
-svg::Document RequestHandler::RenderMap() const {
-    return renderer_.Render(GetAllBuses(), GetAllNonEmptyStops());
+string RequestHandler::RenderRouteOverlay(const graph::Router<double>::RouteInfo& route) const {
+    return GetRenderer().RenderRouteOverlay(GetStopProjection(), GetRouteRides(route));
 }
 
 optional<vector<string>> RequestHandler::ProcessStopRequest(const string& stopname) const {
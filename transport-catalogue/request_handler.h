@@ -4,6 +4,9 @@
 #include "map_renderer.h"
 #include "transport_router.h"
 
+#include <memory>
+#include <optional>
+#include <string>
 #include <unordered_set>
 #include <set>
 
@@ -18,16 +21,29 @@ struct BusRequestResult {
     size_t unique_stop_count;
 };
 
+// JSON-строка карты с маршрутом по частям, которые выводятся подряд без склейки:
+// готовая карта без закрывающего тега, экранированный слой маршрута, закрывающий тег с кавычкой
+struct RouteMapJson {
+    std::string_view map_begin;
+    std::string overlay;
+    std::string_view map_end;
+};
+
 class RequestHandler {
 public:
 
     RequestHandler(const TransportCatalogue& db, const MapRenderer& renderer, const TransportRouter& router);
     
+    // Секции базы загружаются при первом обращении к ним
+    explicit RequestHandler(const serialization::Deserializer& base);
+    
     std::optional<std::vector<std::string>> ProcessStopRequest(const std::string& stopname) const;
     std::optional<BusRequestResult> ProcessBusRequest(const std::string& busname) const;
     
     std::optional<graph::Router<double>::RouteInfo> BuildRoute(std::string_view from, std::string_view to) const;
     const TransportRouter& GetRouter() const;
+    const TransportCatalogue& GetCatalogue() const;
+    const MapRenderer& GetRenderer() const;
 
     BusPtr GetBus(std::string_view bus_name) const;
     std::vector<BusPtr> GetAllBuses() const;
@@ -41,12 +57,44 @@ public:
     
     int GetDistanceBetweenStops(std::string_view from, std::string_view to) const;
 
-    svg::Document RenderMap() const;
+    // Текст SVG-документа
+    std::string RenderMap() const;
+    
+    // Часть карты внутри bbox. Не кешируется: у каждого запроса своя
+    std::string RenderMap(const geo::BoundingBox& bbox, double width, double height) const;
+    
+    // Точки остановок полной карты, считаются один раз при первой отрисовке
+    const renderer::StopProjection& GetStopProjection() const;
+    
+    // Сетка для выборки по прямоугольнику, строится при первом таком запросе
+    const renderer::MapIndex& GetMapIndex() const;
+    
+    // Карта определяется базой целиком, поэтому рисуется один раз, при первом запросе.
+    // Хранится готовой JSON-строкой: в кавычках и с экранированием
+    const std::string& GetMapJson() const;
+    
+    // Полная карта с маршрутом route поверх нее. Рисуется только слой маршрута,
+    // остальное ссылается на готовую карту
+    RouteMapJson GetRouteMapJson(const graph::Router<double>::RouteInfo& route) const;
     
 private:
-    const TransportCatalogue& db_;
-    const MapRenderer& renderer_;
-    const TransportRouter& router_;
+    const serialization::Deserializer* base_ = nullptr;
+    mutable const TransportCatalogue* db_ = nullptr;
+    mutable const MapRenderer* renderer_ = nullptr;
+    mutable const TransportRouter* router_ = nullptr;
+    mutable std::unique_ptr<TransportCatalogue> loaded_db_;
+    mutable std::unique_ptr<MapRenderer> loaded_renderer_;
+    mutable std::unique_ptr<TransportRouter> loaded_router_;
+    mutable std::optional<std::string> map_json_;
+    // Экранированный закрывающий тег, которым кончается map_json_
+    mutable std::string map_json_end_;
+    mutable std::unique_ptr<renderer::MapIndex> map_index_;
+    mutable std::unique_ptr<renderer::StopProjection> stop_projection_;
+    mutable std::optional<std::vector<size_t>> color_indices_;
+    
+    // Поездки маршрута по остановкам, с цветами автобусов полной карты
+    std::vector<renderer::RouteRide> GetRouteRides(const graph::Router<double>::RouteInfo& route) const;
+    std::string RenderRouteOverlay(const graph::Router<double>::RouteInfo& route) const;
 };
 
 } // namespace request_handler
@@ -0,0 +1,302 @@
+#include "requests.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace requests {
+
+namespace {
+
+static_assert(AreHashesDistinct({"Stop", "Bus", "Map", "Route", "RouteMap"}));
+static_assert(AreHashesDistinct({"id", "type", "name", "from", "to", "viewport"}));
+static_assert(AreHashesDistinct({"type", "name", "latitude", "longitude", "road_distances", "stops", "is_roundtrip", "is_removed"}));
+
+MapRequest DecodeMapRequest(const json::FlatNode* viewport) {
+    MapRequest request;
+    if (!viewport) {
+        return request;
+    }
+    const json::FlatDict& settings = viewport->AsMap();
+    request.bbox = geo::BoundingBox{
+        {settings.at("min_lat").AsDouble(), settings.at("min_lng").AsDouble()},
+        {settings.at("max_lat").AsDouble(), settings.at("max_lng").AsDouble()}
+    };
+    request.width = settings.at("width").AsDouble();
+    request.height = settings.at("height").AsDouble();
+    if (!(request.bbox->min.lat < request.bbox->max.lat && request.bbox->min.lng < request.bbox->max.lng)
+        || !(request.width > 0 && request.height > 0)) {
+        throw invalid_argument("invalid map viewport");
+    }
+    return request;
+}
+
+// Обязательное строковое поле запроса данного типа
+string_view RequireField(const optional<string_view>& value, string_view field, string_view type) {
+    if (!value) {
+        throw invalid_argument(string(type) + " request without " + string(field));
+    }
+    return *value;
+}
+
+} // namespace
+
+// Совпадение хеша подтверждается сравнением: посторонний ключ может случайно дать тот же хеш
+StatRequestType ParseStatRequestType(string_view type) {
+    switch (HashKey(type)) {
+        case HashKey("Stop"):
+            return type == "Stop" ? StatRequestType::STOP : StatRequestType::UNKNOWN;
+        case HashKey("Bus"):
+            return type == "Bus" ? StatRequestType::BUS : StatRequestType::UNKNOWN;
+        case HashKey("Map"):
+            return type == "Map" ? StatRequestType::MAP : StatRequestType::UNKNOWN;
+        case HashKey("Route"):
+            return type == "Route" ? StatRequestType::ROUTE : StatRequestType::UNKNOWN;
+        case HashKey("RouteMap"):
+            return type == "RouteMap" ? StatRequestType::ROUTE_MAP : StatRequestType::UNKNOWN;
+        default:
+            return StatRequestType::UNKNOWN;
+    }
+}
+
+StatRequest DecodeStatRequest(const json::FlatNode& node) {
+    StatRequest request;
+    optional<int> id;
+    string_view type;
+    optional<string_view> name, from, to;
+    const json::FlatNode* viewport = nullptr;
+    for (const auto& [key, value] : node.AsMap()) {
+        switch (HashKey(key)) {
+            case HashKey("id"):
+                if (key == "id") {
+                    id = value.AsInt();
+                }
+                break;
+            case HashKey("type"):
+                if (key == "type") {
+                    type = value.AsString();
+                }
+                break;
+            case HashKey("name"):
+                if (key == "name") {
+                    name = value.AsString();
+                }
+                break;
+            case HashKey("from"):
+                if (key == "from") {
+                    from = value.AsString();
+                }
+                break;
+            case HashKey("to"):
+                if (key == "to") {
+                    to = value.AsString();
+                }
+                break;
+            case HashKey("viewport"):
+                if (key == "viewport") {
+                    viewport = &value;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (!id) {
+        throw invalid_argument("stat request without id");
+    }
+    request.id = *id;
+    request.type = ParseStatRequestType(type);
+
+    switch (request.type) {
+        case StatRequestType::STOP:
+            request.data = StopRequest{RequireField(name, "name", type)};
+            break;
+        case StatRequestType::BUS:
+            request.data = BusRequest{RequireField(name, "name", type)};
+            break;
+        case StatRequestType::MAP:
+            request.data = DecodeMapRequest(viewport);
+            break;
+        case StatRequestType::ROUTE:
+            request.data = RouteRequest{RequireField(from, "from", type), RequireField(to, "to", type)};
+            break;
+        case StatRequestType::ROUTE_MAP:
+            request.data = RouteMapRequest{RequireField(from, "from", type), RequireField(to, "to", type)};
+            break;
+        case StatRequestType::UNKNOWN:
+            break;
+    }
+    return request;
+}
+
+BaseRecordReader::Field BaseRecordReader::ParseField(string_view key) {
+    switch (HashKey(key)) {
+        case HashKey("type"):
+            return key == "type" ? Field::TYPE : Field::OTHER;
+        case HashKey("name"):
+            return key == "name" ? Field::NAME : Field::OTHER;
+        case HashKey("latitude"):
+            return key == "latitude" ? Field::LATITUDE : Field::OTHER;
+        case HashKey("longitude"):
+            return key == "longitude" ? Field::LONGITUDE : Field::OTHER;
+        case HashKey("road_distances"):
+            return key == "road_distances" ? Field::ROAD_DISTANCES : Field::OTHER;
+        case HashKey("stops"):
+            return key == "stops" ? Field::STOPS : Field::OTHER;
+        case HashKey("is_roundtrip"):
+            return key == "is_roundtrip" ? Field::IS_ROUNDTRIP : Field::OTHER;
+        case HashKey("is_removed"):
+            return key == "is_removed" ? Field::IS_REMOVED : Field::OTHER;
+        default:
+            return Field::OTHER;
+    }
+}
+
+void BaseRecordReader::StartDict() {
+    if (skipped_depth_ > 0) {
+        ++skipped_depth_;
+    } else if (depth_ == 0) {
+        depth_ = 1;
+    } else if (depth_ == 1 && field_ == Field::ROAD_DISTANCES) {
+        road_distances_.clear();
+        depth_ = 2;
+    } else if (depth_ == 1 && field_ == Field::OTHER) {
+        skipped_depth_ = 1;
+    } else {
+        throw logic_error("invalid type");
+    }
+}
+
+void BaseRecordReader::Key(string key) {
+    if (skipped_depth_ > 0) {
+        return;
+    }
+    if (depth_ == 1) {
+        field_ = ParseField(key);
+    } else {
+        stop_to_ = move(key);
+    }
+}
+
+void BaseRecordReader::EndDict() {
+    if (skipped_depth_ > 0) {
+        --skipped_depth_;
+    } else if (--depth_ == 0) {
+        is_complete_ = true;
+    }
+}
+
+void BaseRecordReader::StartArray() {
+    if (skipped_depth_ > 0) {
+        ++skipped_depth_;
+    } else if (depth_ == 1 && field_ == Field::STOPS) {
+        stops_.emplace();
+        depth_ = 2;
+    } else if (depth_ == 1 && field_ == Field::OTHER) {
+        skipped_depth_ = 1;
+    } else {
+        throw logic_error("invalid type");
+    }
+}
+
+void BaseRecordReader::EndArray() {
+    if (skipped_depth_ > 0) {
+        --skipped_depth_;
+    } else {
+        --depth_;
+    }
+}
+
+namespace {
+
+string TakeString(json::Node::Value& value) {
+    if (string* str = get_if<string>(&value)) {
+        return move(*str);
+    }
+    throw logic_error("invalid type");
+}
+
+} // namespace
+
+void BaseRecordReader::Value(json::Node::Value value) {
+    if (skipped_depth_ > 0) {
+        return;
+    }
+    if (depth_ == 2) {
+        if (field_ == Field::ROAD_DISTANCES) {
+            road_distances_.emplace_back(move(stop_to_), json::Node(move(value)).AsInt());
+        } else {
+            stops_->push_back(TakeString(value));
+        }
+        return;
+    }
+    if (depth_ == 0) {
+        throw logic_error("invalid type");
+    }
+    switch (field_) {
+        case Field::TYPE:
+            type_ = TakeString(value);
+            break;
+        case Field::NAME:
+            name_ = TakeString(value);
+            break;
+        case Field::LATITUDE:
+            latitude_ = json::Node(move(value)).AsDouble();
+            break;
+        case Field::LONGITUDE:
+            longitude_ = json::Node(move(value)).AsDouble();
+            break;
+        case Field::IS_ROUNDTRIP:
+            is_roundtrip_ = json::Node(move(value)).AsBool();
+            break;
+        case Field::IS_REMOVED:
+            is_removed_ = json::Node(move(value)).AsBool();
+            break;
+        case Field::OTHER:
+            break;
+        case Field::ROAD_DISTANCES:
+        case Field::STOPS:
+            throw logic_error("invalid type");
+    }
+}
+
+bool BaseRecordReader::IsInsideRecord() const {
+    return depth_ > 0;
+}
+
+bool BaseRecordReader::IsComplete() const {
+    return is_complete_;
+}
+
+BaseRecord BaseRecordReader::Extract() {
+    BaseRecord result;
+    if (type_ == "Stop") {
+        StopRecord stop;
+        stop.name = move(name_);
+        stop.is_removed = is_removed_;
+        if (latitude_ || longitude_) {
+            if (!latitude_ || !longitude_) {
+                throw invalid_argument("stop with partial coordinates: " + stop.name);
+            }
+            stop.coordinates = geo::Coordinates{*latitude_, *longitude_};
+        }
+        stop.road_distances = move(road_distances_);
+        result = move(stop);
+    } else if (type_ == "Bus") {
+        BusRecord bus;
+        bus.name = move(name_);
+        bus.is_removed = is_removed_;
+        if (!is_removed_) {
+            if (!stops_ || !is_roundtrip_) {
+                throw invalid_argument("bus without stops or is_roundtrip: " + bus.name);
+            }
+            bus.is_roundtrip = *is_roundtrip_;
+            bus.stops = move(*stops_);
+        }
+        result = move(bus);
+    }
+    *this = BaseRecordReader();
+    return result;
+}
+
+} // namespace requests
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "geo.h"
+#include "json.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace requests {
+
+// FNV-1a. Для известных ключей вычисляется при компиляции, поэтому разбор запроса -
+// один проход по его полям с переходом по значению хеша вместо поиска ключей в словаре
+constexpr uint64_t HashKey(std::string_view key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : key) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+constexpr bool AreHashesDistinct(std::initializer_list<std::string_view> keys) {
+    for (auto lhs = keys.begin(); lhs != keys.end(); ++lhs) {
+        for (auto rhs = lhs + 1; rhs != keys.end(); ++rhs) {
+            if (HashKey(*lhs) == HashKey(*rhs)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// ---------- stat_requests ------------------
+
+enum class StatRequestType {
+    STOP,
+    BUS,
+    MAP,
+    ROUTE,
+    ROUTE_MAP,
+    UNKNOWN,
+};
+
+struct StopRequest {
+    std::string_view name;
+};
+
+struct BusRequest {
+    std::string_view name;
+};
+
+// Без bbox - карта всей сети. С bbox - только то, что попадает в прямоугольник,
+// вписанный в изображение width x height
+struct MapRequest {
+    std::optional<geo::BoundingBox> bbox;
+    double width = 0;
+    double height = 0;
+};
+
+struct RouteRequest {
+    std::string_view from;
+    std::string_view to;
+};
+
+// Маршрут, нарисованный поверх полной карты
+struct RouteMapRequest {
+    std::string_view from;
+    std::string_view to;
+};
+
+struct UnknownRequest {
+};
+
+// Строки ссылаются на документ запросов
+struct StatRequest {
+    int id = 0;
+    StatRequestType type = StatRequestType::UNKNOWN;
+    std::variant<StopRequest, BusRequest, MapRequest, RouteRequest, RouteMapRequest, UnknownRequest> data = UnknownRequest{};
+};
+
+StatRequestType ParseStatRequestType(std::string_view type);
+
+StatRequest DecodeStatRequest(const json::FlatNode& node);
+
+// ---------- base_requests ------------------
+
+struct StopRecord {
+    std::string name;
+    std::optional<geo::Coordinates> coordinates;
+    std::vector<std::pair<std::string, int>> road_distances;
+    bool is_removed = false;
+};
+
+struct BusRecord {
+    std::string name;
+    std::vector<std::string> stops;
+    bool is_roundtrip = false;
+    bool is_removed = false;
+};
+
+using BaseRecord = std::variant<std::monostate, StopRecord, BusRecord>;
+
+// Собирает запись base_requests прямо из событий потокового разбора, без промежуточного json::Node.
+// События подаются начиная с открытия словаря записи, пока IsComplete() не вернет true
+class BaseRecordReader : public json::Handler {
+public:
+    void StartDict() override;
+    void Key(std::string key) override;
+    void EndDict() override;
+    void StartArray() override;
+    void EndArray() override;
+    void Value(json::Node::Value value) override;
+
+    bool IsInsideRecord() const;
+    bool IsComplete() const;
+
+    // Отдает собранную запись и готовит читатель к следующей
+    BaseRecord Extract();
+
+private:
+    enum class Field {
+        TYPE,
+        NAME,
+        LATITUDE,
+        LONGITUDE,
+        ROAD_DISTANCES,
+        STOPS,
+        IS_ROUNDTRIP,
+        IS_REMOVED,
+        OTHER,
+    };
+
+    static Field ParseField(std::string_view key);
+
+    // 1 - в словаре записи, 2 - в road_distances или stops
+    int depth_ = 0;
+    // Вложенность пропускаемого значения незнакомого поля
+    int skipped_depth_ = 0;
+    bool is_complete_ = false;
+    Field field_ = Field::OTHER;
+
+    std::string type_;
+    std::string name_;
+    std::optional<double> latitude_;
+    std::optional<double> longitude_;
+    std::string stop_to_;
+    std::vector<std::pair<std::string, int>> road_distances_;
+    std::optional<std::vector<std::string>> stops_;
+    std::optional<bool> is_roundtrip_;
+    bool is_removed_ = false;
+};
+
+} // namespace requests
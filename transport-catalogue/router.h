@@ -5,8 +5,10 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <functional>
 #include <iterator>
 #include <optional>
+#include <queue>
 #include <stdexcept>
 #include <unordered_map>
 #include <utility>
@@ -37,8 +39,8 @@ public:
     
     explicit Router(const Graph& graph);
     
-    Router(const Graph& graph, const RoutesInternalData& route_internal_data)
-        : graph_(graph), routes_internal_data_(route_internal_data)
+    Router(const Graph& graph, RoutesInternalData route_internal_data)
+        : graph_(graph), routes_internal_data_(std::move(route_internal_data))
     {
     }
     
@@ -49,6 +51,12 @@ public:
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
     
+    // Пересчитывает строку матрицы маршрутов для вершины from алгоритмом Дейкстры
+    void RecomputeRoutesFrom(VertexId from);
+    
+    // Учитывает в матрице маршрутов ребро, уже добавленное в граф, за O(V^2)
+    void AddEdge(EdgeId edge_id);
+    
     const Graph& GetGraph() const {
         return graph_;
     }
@@ -125,6 +133,67 @@ Router<Weight>::Router(const Graph& graph)
     }
 }
 
+template <typename Weight>
+void Router<Weight>::RecomputeRoutesFrom(VertexId from) {
+    auto& routes_from = routes_internal_data_.at(from);
+    std::fill(routes_from.begin(), routes_from.end(), std::nullopt);
+    routes_from[from] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+    
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    queue.push({ZERO_WEIGHT, from});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > routes_from[vertex]->weight) {
+            continue;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (edge.weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            const Weight candidate_weight = weight + edge.weight;
+            auto& route_to = routes_from[edge.to];
+            if (!route_to || candidate_weight < route_to->weight) {
+                route_to = RouteInternalData{candidate_weight, edge_id};
+                queue.push({candidate_weight, edge.to});
+            }
+        }
+    }
+}
+
+template <typename Weight>
+void Router<Weight>::AddEdge(EdgeId edge_id) {
+    const auto& edge = graph_.GetEdge(edge_id);
+    if (edge.weight < ZERO_WEIGHT) {
+        throw std::domain_error("Edges' weights should be non-negative");
+    }
+    // Маршруты из edge.to и в edge.from при добавлении ребра не сокращаются,
+    // поэтому их можно читать, обновляя остальные строки матрицы
+    const auto& routes_from_edge_end = routes_internal_data_.at(edge.to);
+    const size_t vertex_count = routes_internal_data_.size();
+    for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
+        auto& routes_from = routes_internal_data_[vertex_from];
+        if (!routes_from[edge.from]) {
+            continue;
+        }
+        const Weight weight_to_edge_end = routes_from[edge.from]->weight + edge.weight;
+        for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
+            const auto& route_from_edge_end = routes_from_edge_end[vertex_to];
+            if (!route_from_edge_end) {
+                continue;
+            }
+            const Weight candidate_weight = weight_to_edge_end + route_from_edge_end->weight;
+            auto& route_relaxing = routes_from[vertex_to];
+            if (!route_relaxing || candidate_weight < route_relaxing->weight) {
+                route_relaxing = {candidate_weight,
+                                  route_from_edge_end->prev_edge ? route_from_edge_end->prev_edge : edge_id};
+            }
+        }
+    }
+}
+
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
@@ -1,73 +1,414 @@
 #include "serialization.h"
+#include "json_builder.h"
+#include "map_renderer.h"
 
 #include <fstream>
+#include <map>
 using namespace std;
 using namespace json;
 
 namespace serialization {
 
+namespace {
+
+void WriteFixed32(ostream& out, uint32_t value) {
+    char bytes[4];
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+    out.write(bytes, 4);
+}
+
+uint32_t ReadFixed32(istream& in) {
+    unsigned char bytes[4] = {};
+    in.read(reinterpret_cast<char*>(bytes), 4);
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+} // namespace
+
+// Корневые настройки собираются целиком, записи base_requests читаются сразу в структуры и передаются сериализатору по одной
+class Serializer::InputHandler : public json::Handler {
+public:
+    explicit InputHandler(Serializer& serializer)
+        : serializer_(serializer) {
+    }
+    
+    void StartDict() override {
+        if (depth_ == 0) {
+            depth_ = 1;
+            return;
+        }
+        if (depth_ == 2) {
+            record_reader_.StartDict();
+            return;
+        }
+        builder_.StartDict();
+        ++value_depth_;
+    }
+    
+    void Key(string key) override {
+        if (depth_ == 2) {
+            record_reader_.Key(move(key));
+            return;
+        }
+        if (value_depth_ > 0) {
+            builder_.Key(move(key));
+            return;
+        }
+        key_ = move(key);
+    }
+    
+    void EndDict() override {
+        if (depth_ == 2) {
+            record_reader_.EndDict();
+            FinishRecord();
+            return;
+        }
+        if (value_depth_ == 0) {
+            depth_ = 0;
+            return;
+        }
+        builder_.EndDict();
+        FinishValue();
+    }
+    
+    void StartArray() override {
+        if (depth_ == 0) {
+            throw invalid_argument("make_base input must be a dict");
+        }
+        if (depth_ == 2) {
+            record_reader_.StartArray();
+            return;
+        }
+        if (depth_ == 1 && value_depth_ == 0 && key_ == "base_requests") {
+            depth_ = 2;
+            return;
+        }
+        builder_.StartArray();
+        ++value_depth_;
+    }
+    
+    void EndArray() override {
+        if (depth_ == 2) {
+            if (record_reader_.IsInsideRecord()) {
+                record_reader_.EndArray();
+            } else {
+                depth_ = 1;
+            }
+            return;
+        }
+        builder_.EndArray();
+        FinishValue();
+    }
+    
+    void Value(Node::Value value) override {
+        if (depth_ == 0) {
+            throw invalid_argument("make_base input must be a dict");
+        }
+        if (depth_ == 2) {
+            record_reader_.Value(move(value));
+            FinishRecord();
+            return;
+        }
+        builder_.Value(move(value));
+        ++value_depth_;
+        FinishValue();
+    }
+    
+private:
+    Serializer& serializer_;
+    // 1 - внутри корня, 2 - внутри base_requests
+    int depth_ = 0;
+    // Вложенность собираемого значения
+    int value_depth_ = 0;
+    string key_;
+    json::Builder builder_;
+    requests::BaseRecordReader record_reader_;
+    
+    void FinishValue() {
+        if (--value_depth_ > 0) {
+            return;
+        }
+        Node value = builder_.Build();
+        builder_ = json::Builder();
+        serializer_.AddSetting(key_, move(value));
+    }
+    
+    void FinishRecord() {
+        if (record_reader_.IsComplete()) {
+            serializer_.SerializeRecord(record_reader_.Extract());
+        }
+    }
+};
+
+Serializer::Serializer()
+    : transport_catalogue_(google::protobuf::Arena::CreateMessage<TransportCatalogue>(&arena_)),
+      render_settings_(google::protobuf::Arena::CreateMessage<RenderSettings>(&arena_)),
+      router_graph_(google::protobuf::Arena::CreateMessage<RouterGraph>(&arena_))
+{
+}
+
+Serializer::~Serializer() = default;
+
 void Serializer::SerializeFromInput(istream& input) {
-    requests_ = json::Load(input);
-    base_requests_ = requests_.GetRoot().AsMap().at("base_requests").AsArray();
-    
-    SerializeStops();
-    SerializeDistancesAndBuses();
-    SerializeRoutingSettings();
-    SerializeRouter();
-    SerializeRenderSettings();
+    InputHandler handler(*this);
+    json::Parse(input, handler);
+    if (!is_catalogue_started_) {
+        StartCatalogue();
+    }
+    
+    ResolveStopReferences();
+    RemoveBuses();
+    RemoveStops();
+    ComputeStopZoomLevels();
+    
+    if (!previous_ || settings_.count("routing_settings")) {
+        SerializeRoutingSettings();
+    }
+    if (!previous_ || settings_.count("render_settings")) {
+        SerializeRenderSettings();
+    } else {
+        render_settings_->CopyFrom(previous_->GetRenderSettings());
+    }
+    
+    bool is_same_routing_settings = false;
+    if (previous_) {
+        const auto& previous_catalogue = previous_->GetTransportCatalogue();
+        is_same_routing_settings = previous_catalogue.bus_wait_time() == transport_catalogue_->bus_wait_time()
+            && previous_catalogue.bus_velocity() == transport_catalogue_->bus_velocity();
+    }
+    SerializeRouter(is_same_routing_settings ? previous_.get() : nullptr);
     SerializeToOstream();
 }
 
-void Serializer::SerializeStops() {
-    size_t stop_counter = 0;
-    for (const Node& node : base_requests_) {
-        if (node.AsMap().at("type").AsString() != "Stop") {
+void Serializer::AddSetting(const string& key, Node value) {
+    settings_.emplace(key, move(value));
+    if (key == "serialization_settings" && !is_catalogue_started_) {
+        StartCatalogue();
+        for (requests::BaseRecord& record : delayed_records_) {
+            SerializeRecord(move(record));
+        }
+        delayed_records_.clear();
+    }
+}
+
+// Записи применяются к каталогу предыдущей базы (previous_file) или к пустому:
+// остановки и автобусы добавляются, заменяются или удаляются (признак is_removed), расстояния дополняются
+void Serializer::StartCatalogue() {
+    is_catalogue_started_ = true;
+    const auto& serialization_settings = settings_.at("serialization_settings").AsMap();
+    if (!serialization_settings.count("previous_file")) {
+        return;
+    }
+    
+    previous_ = make_unique<Deserializer>(serialization_settings.at("previous_file").AsString());
+    transport_catalogue_->CopyFrom(previous_->GetTransportCatalogue());
+    for (int i = 0; i < transport_catalogue_->stop_size(); ++i) {
+        stopname_to_index_[transport_catalogue_->stop(i).name()] = i;
+    }
+    for (FromToDistance& from_to_dist : *(transport_catalogue_->mutable_from_to_distance())) {
+        distances_[{from_to_dist.from(), from_to_dist.to()}] = &from_to_dist;
+    }
+    for (Bus& bus : *(transport_catalogue_->mutable_bus())) {
+        buses_[bus.name()] = &bus;
+    }
+}
+
+void Serializer::SerializeRecord(requests::BaseRecord record) {
+    // Пока неизвестно, строится ли база от предыдущей, записи придерживаются
+    if (!is_catalogue_started_) {
+        delayed_records_.push_back(move(record));
+        return;
+    }
+    
+    if (auto* stop = get_if<requests::StopRecord>(&record)) {
+        if (stop->is_removed) {
+            removed_stops_.insert(move(stop->name));
+        } else {
+            SerializeStop(move(*stop));
+        }
+    } else if (auto* bus = get_if<requests::BusRecord>(&record)) {
+        if (bus->is_removed) {
+            removed_buses_.insert(move(bus->name));
+        } else {
+            SerializeBus(move(*bus));
+        }
+    }
+}
+
+void Serializer::SerializeStop(requests::StopRecord stop) {
+    if (!removed_stops_.empty()) {
+        removed_stops_.erase(stop.name);
+    }
+    
+    Stop* stop_serialized;
+    auto it = stopname_to_index_.find(stop.name);
+    // Без координат - только остановка предыдущей базы в дельте: координаты сохраняются
+    if (!stop.coordinates && (!previous_ || it == stopname_to_index_.end())) {
+        throw invalid_argument("stop without coordinates: " + stop.name);
+    }
+    if (it != stopname_to_index_.end()) {
+        stop_serialized = transport_catalogue_->mutable_stop(it->second);
+    } else {
+        const size_t index = transport_catalogue_->stop_size();
+        stop_serialized = transport_catalogue_->add_stop();
+        stop_serialized->set_name(move(stop.name));
+        // Ключи индексов ссылаются на имена в каталоге
+        it = stopname_to_index_.emplace(stop_serialized->name(), index).first;
+    }
+    if (stop.coordinates) {
+        stop_serialized->mutable_coordinates()->set_lat(stop.coordinates->lat);
+        stop_serialized->mutable_coordinates()->set_lng(stop.coordinates->lng);
+    }
+    
+    for (auto& [stop_to, distance] : stop.road_distances) {
+        pending_distances_.push_back({static_cast<uint32_t>(it->second), move(stop_to), distance});
+    }
+}
+
+void Serializer::SerializeBus(requests::BusRecord record) {
+    if (!removed_buses_.empty()) {
+        removed_buses_.erase(record.name);
+    }
+    Bus* bus;
+    auto bus_it = buses_.find(record.name);
+    if (bus_it != buses_.end()) {
+        bus = bus_it->second;
+    } else {
+        bus = transport_catalogue_->add_bus();
+        bus->set_name(move(record.name));
+        buses_.emplace(bus->name(), bus);
+    }
+    bus->set_is_roundtrip(record.is_roundtrip);
+    bus->clear_stop_index();
+    pending_bus_stops_.erase(bus);
+    
+    bus->mutable_stop_index()->Reserve(record.stops.size());
+    for (const string& stopname : record.stops) {
+        auto it = stopname_to_index_.find(stopname);
+        if (it == stopname_to_index_.end()) {
+            // Остановка описана ниже по потоку - маршрут разрешается в конце
+            bus->clear_stop_index();
+            pending_bus_stops_[bus] = move(record.stops);
+            return;
+        }
+        bus->add_stop_index(it->second);
+    }
+}
+
+uint32_t Serializer::GetStopIndex(string_view stopname) const {
+    auto it = stopname_to_index_.find(stopname);
+    if (it == stopname_to_index_.end()) {
+        throw invalid_argument("unknown stop: " + string(stopname));
+    }
+    return it->second;
+}
+
+void Serializer::ResolveStopReferences() {
+    for (const auto& [stop_from, stop_to, distance] : pending_distances_) {
+        const uint32_t stop_to_index = GetStopIndex(stop_to);
+        FromToDistance*& from_to_dist = distances_[{stop_from, stop_to_index}];
+        if (!from_to_dist) {
+            from_to_dist = transport_catalogue_->add_from_to_distance();
+            from_to_dist->set_from(stop_from);
+            from_to_dist->set_to(stop_to_index);
+        }
+        from_to_dist->set_distance(distance);
+    }
+    pending_distances_.clear();
+    
+    for (const auto& [bus, stopnames] : pending_bus_stops_) {
+        for (const string& stopname : stopnames) {
+            bus->add_stop_index(GetStopIndex(stopname));
+        }
+    }
+    pending_bus_stops_.clear();
+}
+
+void Serializer::RemoveBuses() {
+    auto* all_buses = transport_catalogue_->mutable_bus();
+    int kept_count = 0;
+    for (int i = 0; i < all_buses->size(); ++i) {
+        if (removed_buses_.count(all_buses->Get(i).name())) {
             continue;
         }
-        map<string, Node> stop = node.AsMap();
-        stopname_to_index_[stop.at("name").AsString()] = stop_counter++;
-        Stop stop_serialized;
-        *(stop_serialized.mutable_name()) = (stop.at("name").AsString());
-        stop_serialized.mutable_coordinates()->set_lat(stop.at("latitude").AsDouble());
-        stop_serialized.mutable_coordinates()->set_lng(stop.at("longitude").AsDouble());
-        *(transport_catalogue_.add_stop()) = stop_serialized;
-    }
-}
-
-void Serializer::SerializeDistancesAndBuses() {
-    for (const Node& node : base_requests_) {
-        if (node.AsMap().at("type").AsString() == "Stop") {
-            map<string, Node> stop = node.AsMap();
-            string stop_from = stop.at("name").AsString();
-            FromToDistance tmp_from_to_dist;
-            tmp_from_to_dist.set_from(stopname_to_index_[stop_from]);
-            for (const auto& [stop_to, distance] : stop.at("road_distances").AsMap()) {
-                tmp_from_to_dist.set_to(stopname_to_index_[stop_to]);
-                tmp_from_to_dist.set_distance(distance.AsInt());
-                *(transport_catalogue_.add_from_to_distance()) = tmp_from_to_dist;
-            }
+        all_buses->SwapElements(kept_count++, i);
+    }
+    all_buses->DeleteSubrange(kept_count, all_buses->size() - kept_count);
+}
+
+void Serializer::RemoveStops() {
+    if (removed_stops_.empty()) {
+        return;
+    }
+    
+    const uint32_t REMOVED = -1;
+    vector<uint32_t> new_index(transport_catalogue_->stop_size(), REMOVED);
+    auto* all_stops = transport_catalogue_->mutable_stop();
+    int kept_count = 0;
+    for (int i = 0; i < all_stops->size(); ++i) {
+        if (removed_stops_.count(all_stops->Get(i).name())) {
+            stopname_to_index_.erase(all_stops->Get(i).name());
+            continue;
         }
-        
-        if (node.AsMap().at("type").AsString() == "Bus") {
-            Bus tmp_bus;
-            tmp_bus.set_is_roundtrip(node.AsMap().at("is_roundtrip").AsBool());
-            tmp_bus.set_name(node.AsMap().at("name").AsString());
-            for (const Node& stopname : node.AsMap().at("stops").AsArray()) {
-                tmp_bus.add_stop_index(stopname_to_index_[stopname.AsString()]);
+        new_index[i] = kept_count;
+        stopname_to_index_[all_stops->Get(i).name()] = kept_count;
+        all_stops->SwapElements(kept_count++, i);
+    }
+    all_stops->DeleteSubrange(kept_count, all_stops->size() - kept_count);
+    
+    for (Bus& bus : *(transport_catalogue_->mutable_bus())) {
+        for (int i = 0; i < bus.stop_index_size(); ++i) {
+            if (new_index[bus.stop_index(i)] == REMOVED) {
+                throw invalid_argument("removed stop is used by bus " + bus.name());
             }
-            *(transport_catalogue_.add_bus()) = tmp_bus;
+            bus.set_stop_index(i, new_index[bus.stop_index(i)]);
+        }
+    }
+    
+    auto* distances = transport_catalogue_->mutable_from_to_distance();
+    kept_count = 0;
+    for (int i = 0; i < distances->size(); ++i) {
+        FromToDistance* from_to_dist = distances->Mutable(i);
+        if (new_index[from_to_dist->from()] == REMOVED || new_index[from_to_dist->to()] == REMOVED) {
+            continue;
+        }
+        from_to_dist->set_from(new_index[from_to_dist->from()]);
+        from_to_dist->set_to(new_index[from_to_dist->to()]);
+        distances->SwapElements(kept_count++, i);
+    }
+    distances->DeleteSubrange(kept_count, distances->size() - kept_count);
+}
+
+// Считаются заново для всех маршрутов: у замененных остановок могли измениться координаты
+void Serializer::ComputeStopZoomLevels() {
+    vector<geo::Coordinates> points;
+    for (Bus& bus : *(transport_catalogue_->mutable_bus())) {
+        points.clear();
+        for (uint32_t stop_index : bus.stop_index()) {
+            const Coordinates& coordinates = transport_catalogue_->stop(stop_index).coordinates();
+            points.push_back({coordinates.lat(), coordinates.lng()});
+        }
+        bus.clear_stop_zoom();
+        for (uint8_t level : renderer::ComputeZoomLevels(points)) {
+            bus.add_stop_zoom(level);
         }
     }
 }
 
 void Serializer::SerializeRoutingSettings() {
-    transport_catalogue_.set_bus_wait_time(requests_.GetRoot().AsMap().at("routing_settings").AsMap().at("bus_wait_time").AsInt());
-    transport_catalogue_.set_bus_velocity(requests_.GetRoot().AsMap().at("routing_settings").AsMap().at("bus_velocity").AsInt());
+    transport_catalogue_->set_bus_wait_time(settings_.at("routing_settings").AsMap().at("bus_wait_time").AsInt());
+    transport_catalogue_->set_bus_velocity(settings_.at("routing_settings").AsMap().at("bus_velocity").AsInt());
 }
 
 void Serializer::SerializeRenderSettings() {
-    auto settings = requests_.GetRoot().AsMap().at("render_settings").AsMap();
-    RenderSettings render_settings;
+    const auto& settings = settings_.at("render_settings").AsMap();
+    RenderSettings& render_settings = *render_settings_;
     
     render_settings.set_width(settings.at("width").AsDouble());
     render_settings.set_height(settings.at("height").AsDouble());
@@ -83,118 +424,283 @@ void Serializer::SerializeRenderSettings() {
     render_settings.mutable_stop_label_offset()->set_x(settings.at("stop_label_offset").AsArray()[0].AsDouble());
     render_settings.mutable_stop_label_offset()->set_y(settings.at("stop_label_offset").AsArray()[1].AsDouble());
     
-    *(render_settings.mutable_underlayer_color()) = ReadColor(settings.at("underlayer_color"));
+    ReadColor(settings.at("underlayer_color"), render_settings.mutable_underlayer_color());
     
     for (const Node& color_node : settings.at("color_palette").AsArray()) {
-        render_settings.mutable_color_palette()->Add(ReadColor(color_node));
+        ReadColor(color_node, render_settings.add_color_palette());
     }
     
-    *(transport_catalogue_.mutable_render_settings()) = render_settings;
+    if (settings.count("svg_precision")) {
+        const int decimals = settings.at("svg_precision").AsInt();
+        if (decimals < 0) {
+            throw invalid_argument("invalid svg_precision");
+        }
+        render_settings.mutable_svg_number_format()->set_decimals(decimals);
+    }
 }
 
-Color Serializer::ReadColor(const json::Node& color_node) {
-    Color result;
+void Serializer::ReadColor(const json::Node& color_node, Color* result) {
     if (color_node.IsString()) {
-        result.set_color_string(color_node.AsString());
-        return result;
+        result->set_color_string(color_node.AsString());
+        return;
     }
     int red, green, blue;
     red = color_node.AsArray()[0].AsInt();
     green = color_node.AsArray()[1].AsInt();
     blue = color_node.AsArray()[2].AsInt();
-    result.add_color_rgb(red);
-    result.add_color_rgb(green);
-    result.add_color_rgb(blue);
+    result->add_color_rgb(red);
+    result->add_color_rgb(green);
+    result->add_color_rgb(blue);
     if (color_node.AsArray().size() == 3) {
-        result.set_is_rgb(true);
-        return result;
+        result->set_is_rgb(true);
+        return;
     }
-    result.set_opasity(color_node.AsArray()[3].AsDouble());
-    result.set_is_rgb(false);
-    return result;
+    result->set_opasity(color_node.AsArray()[3].AsDouble());
+    result->set_is_rgb(false);
 }
 
-void Serializer::SerializeRouter() {
-    transport_catalogue::TransportCatalogue transport_catalogue_usual(transport_catalogue_);
+void Serializer::SerializeRouter(const Deserializer* previous) {
+    transport_catalogue::TransportCatalogue transport_catalogue_usual(*transport_catalogue_);
     transport_catalogue::TransportRouter router_usual(transport_catalogue_usual);
     router_usual.BuildGraph();
-    router_usual.BuildRouter();
     auto graph_usual = router_usual.GetGraph();
     
     SerializeIdToVertex(router_usual.GetIdToVertex());
     
-    Router router = SerializeRouteInternalData(router_usual);;
-    *(router.mutable_graph()) = SerializeGraph(graph_usual);
+    SerializeGraph(graph_usual, router_graph_->mutable_graph());
     
-    *(transport_catalogue_.mutable_router()) = router;
+    const string mode = GetRoutingTableMode();
+    if (mode == "packed") {
+        if (previous) {
+            transport_catalogue::TransportRouter previous_router(previous->GetRouterGraph(), previous->GetRoutesTable());
+            router_usual.BuildRouterFrom(previous_router);
+        } else {
+            router_usual.BuildRouter();
+        }
+        routes_table_ = google::protobuf::Arena::CreateMessage<RoutesTable>(&arena_);
+        SerializeRoutesTable(router_usual, routes_table_);
+    } else if (mode != "lazy") {
+        throw invalid_argument("unknown routing_table mode: " + mode);
+    }
+}
+
+string Serializer::GetRoutingTableMode() const {
+    const auto& settings = settings_.at("serialization_settings").AsMap();
+    auto it = settings.find("routing_table");
+    if (it == settings.end()) {
+        return "packed";
+    }
+    return it->second.AsString();
 }
 
 void Serializer::SerializeIdToVertex(const std::vector<VertexUsual>& id_to_vertex) {
+    router_graph_->mutable_id_to_vertex()->Reserve(id_to_vertex.size());
     for (const auto& vertex_usual : id_to_vertex) {
-        Vertex vertex;
-        vertex.set_stopname(vertex_usual.stopname);
-        vertex.set_is_waiting(vertex_usual.is_waiting);
-        *(transport_catalogue_.add_id_to_vertex()) = vertex;
+        Vertex* vertex = router_graph_->add_id_to_vertex();
+        vertex->set_stopname(vertex_usual.stopname);
+        vertex->set_is_waiting(vertex_usual.is_waiting);
     }
 }
 
-Graph Serializer::SerializeGraph(const graph::DirectedWeightedGraph<double>& graph_usual) {
-    Graph result;
+void Serializer::SerializeGraph(const graph::DirectedWeightedGraph<double>& graph_usual, Graph* result) {
+    result->mutable_edge()->Reserve(graph_usual.GetEdgeCount());
     for (size_t i = 0; i < graph_usual.GetEdgeCount(); ++i) {
-        *(result.add_edge()) = SerializeEdge(graph_usual.GetEdge(i));
+        SerializeEdge(graph_usual.GetEdge(i), result->add_edge());
     }
     
+    result->mutable_incidence_list()->Reserve(graph_usual.GetVertexCount());
     for (size_t i = 0; i < graph_usual.GetVertexCount(); ++i) {
-        *(result.add_incidence_list()) = SerializeIncidenceList(graph_usual.GetIncidentEdges(i));
+        SerializeIncidenceList(graph_usual.GetIncidentEdges(i), result->add_incidence_list());
     }
-    return result;
 }
 
-Edge Serializer::SerializeEdge(const graph::Edge<double>& edge_usual) {
-    Edge result;
-    result.set_from(edge_usual.from);
-    result.set_to(edge_usual.to);
-    result.set_weight(edge_usual.weight);
-    result.set_stop_count(edge_usual.stop_count);
-    result.set_busname(edge_usual.busname);
-    return result;
+void Serializer::SerializeEdge(const graph::Edge<double>& edge_usual, Edge* result) {
+    result->set_from(edge_usual.from);
+    result->set_to(edge_usual.to);
+    result->set_weight(edge_usual.weight);
+    result->set_stop_count(edge_usual.stop_count);
+    result->set_busname(edge_usual.busname);
 }
 
-Router Serializer::SerializeRouteInternalData(const transport_catalogue::TransportRouter& router_usual) {
-    Router result;
-    auto* router_usual_ptr = router_usual.GetRouter();
+void Serializer::SerializeRoutesTable(const transport_catalogue::TransportRouter& router_usual, RoutesTable* result) {
+    const auto& routes_internal_data = router_usual.GetRouter()->GetRoutesInternalData();
+    const size_t vertex_count = routes_internal_data.size();
+    result->set_vertex_count(vertex_count);
+    result->mutable_weight()->Reserve(vertex_count * vertex_count);
+    result->mutable_prev_edge()->Reserve(vertex_count * vertex_count);
     
-    for(const auto& router_internal_data_list_usual : router_usual_ptr->GetRoutesInternalData()) {
-        
-        RouteInternalDataList router_internal_data_list;
+    for (const auto& router_internal_data_list_usual : routes_internal_data) {
         for (const auto& internal_data_usual : router_internal_data_list_usual) {
-            RouteInternalData route_internal_data;
-            if (internal_data_usual) {
-                route_internal_data.set_weight(internal_data_usual->weight);
-            } else {
-                route_internal_data.set_weight(-1);
-                *(router_internal_data_list.add_route_internal_data()) = route_internal_data;
+            if (!internal_data_usual) {
+                result->add_weight(-1);
+                result->add_prev_edge(0);
                 continue;
             }
-            if (internal_data_usual->prev_edge) {
-                route_internal_data.set_prev_edge(*(internal_data_usual->prev_edge));
-                route_internal_data.set_is_prev_edge(true);
-            } else {
-                route_internal_data.set_is_prev_edge(false);
-            }
-            *(router_internal_data_list.add_route_internal_data()) = route_internal_data;
+            result->add_weight(internal_data_usual->weight);
+            result->add_prev_edge(internal_data_usual->prev_edge ? *(internal_data_usual->prev_edge) + 1 : 0);
         }
-        *(result.add_route_internal_data_list()) = router_internal_data_list;
     }
-    return result;
 }
 
 
 void Serializer::SerializeToOstream() const {
-    ofstream out(requests_.GetRoot().AsMap().at("serialization_settings").AsMap().at("file").AsString());
-    transport_catalogue_.SerializeToOstream(&out);
+    vector<pair<Section::Type, const google::protobuf::Message*>> sections = {
+        {Section::CATALOGUE, transport_catalogue_},
+        {Section::RENDER_SETTINGS, render_settings_},
+        {Section::ROUTER_GRAPH, router_graph_}
+    };
+    if (routes_table_) {
+        sections.push_back({Section::ROUTES_TABLE, routes_table_});
+    }
+    
+    BaseIndex index;
+    uint64_t offset = 0;
+    for (const auto& [type, message] : sections) {
+        Section* section = index.add_section();
+        section->set_type(type);
+        section->set_offset(offset);
+        section->set_size(message->ByteSizeLong());
+        offset += section->size();
+    }
+    
+    ofstream out(settings_.at("serialization_settings").AsMap().at("file").AsString(), ios::binary);
+    out.write(BASE_FORMAT_MAGIC.data(), BASE_FORMAT_MAGIC.size());
+    WriteFixed32(out, index.ByteSizeLong());
+    index.SerializeToOstream(&out);
+    for (const auto& [type, message] : sections) {
+        message->SerializeToOstream(&out);
+    }
+}
+
+
+Deserializer::Deserializer(const string& file)
+    : input_(file, ios::binary)
+{
+    if (!input_) {
+        throw invalid_argument("cannot open base file: " + file);
+    }
+    ReadIndex();
+}
+
+void Deserializer::ReadIndex() {
+    string magic(BASE_FORMAT_MAGIC.size(), '\0');
+    input_.read(magic.data(), magic.size());
+    if (!input_ || magic != BASE_FORMAT_MAGIC) {
+        is_legacy_format_ = true;
+        return;
+    }
+    
+    string index_bytes(ReadFixed32(input_), '\0');
+    input_.read(index_bytes.data(), index_bytes.size());
+    BaseIndex index;
+    if (!input_ || !index.ParseFromString(index_bytes)) {
+        throw invalid_argument("corrupted base index");
+    }
+    for (const Section& section : index.section()) {
+        sections_[section.type()] = section;
+    }
+    sections_begin_ = input_.tellg();
 }
+
+bool Deserializer::LoadSection(Section::Type type, google::protobuf::Message* message) const {
+    auto it = sections_.find(type);
+    if (it == sections_.end()) {
+        return false;
+    }
+    string bytes(it->second.size(), '\0');
+    input_.clear();
+    input_.seekg(sections_begin_ + static_cast<streamoff>(it->second.offset()));
+    input_.read(bytes.data(), bytes.size());
+    if (!input_ || !message->ParseFromString(bytes)) {
+        throw invalid_argument("corrupted base section " + Section::Type_Name(type));
+    }
+    return true;
+}
+
+void Deserializer::LoadRequiredSection(Section::Type type, google::protobuf::Message* message) const {
+    if (!LoadSection(type, message)) {
+        throw invalid_argument("missing base section " + Section::Type_Name(type));
+    }
+}
+
+// База в старом формате - одно сообщение TransportCatalogue, разбираем его целиком
+void Deserializer::LoadLegacyBase() const {
+    input_.clear();
+    input_.seekg(0);
+    auto* whole_base = google::protobuf::Arena::CreateMessage<TransportCatalogue>(&arena_);
+    if (!whole_base->ParseFromIstream(&input_)) {
+        throw invalid_argument("corrupted base file");
+    }
+    
+    render_settings_ = whole_base->mutable_render_settings();
+    
+    router_graph_ = google::protobuf::Arena::CreateMessage<RouterGraph>(&arena_);
+    router_graph_->mutable_graph()->Swap(whole_base->mutable_router()->mutable_graph());
+    router_graph_->mutable_id_to_vertex()->Swap(whole_base->mutable_id_to_vertex());
     
+    const Router& router = whole_base->router();
+    if (router.routes_table().vertex_count() > 0) {
+        routes_table_ = whole_base->mutable_router()->mutable_routes_table();
+    } else if (router.route_internal_data_list_size() > 0) {
+        routes_table_ = google::protobuf::Arena::CreateMessage<RoutesTable>(&arena_);
+        routes_table_->set_vertex_count(router.route_internal_data_list_size());
+        for (const RouteInternalDataList& list : router.route_internal_data_list()) {
+            for (const RouteInternalData& data : list.route_internal_data()) {
+                routes_table_->add_weight(data.weight());
+                routes_table_->add_prev_edge(data.weight() >= 0 && data.is_prev_edge() ? data.prev_edge() + 1 : 0);
+            }
+        }
+    }
+    is_routes_table_loaded_ = true;
+    transport_catalogue_ = whole_base;
+}
+
+const TransportCatalogue& Deserializer::GetTransportCatalogue() const {
+    if (is_legacy_format_ && !transport_catalogue_) {
+        LoadLegacyBase();
+    }
+    if (!transport_catalogue_) {
+        transport_catalogue_ = google::protobuf::Arena::CreateMessage<TransportCatalogue>(&arena_);
+        LoadRequiredSection(Section::CATALOGUE, transport_catalogue_);
+    }
+    return *transport_catalogue_;
+}
+
+const RenderSettings& Deserializer::GetRenderSettings() const {
+    if (is_legacy_format_ && !transport_catalogue_) {
+        LoadLegacyBase();
+    }
+    if (!render_settings_) {
+        render_settings_ = google::protobuf::Arena::CreateMessage<RenderSettings>(&arena_);
+        LoadRequiredSection(Section::RENDER_SETTINGS, render_settings_);
+    }
+    return *render_settings_;
+}
+
+const RouterGraph& Deserializer::GetRouterGraph() const {
+    if (is_legacy_format_ && !transport_catalogue_) {
+        LoadLegacyBase();
+    }
+    if (!router_graph_) {
+        router_graph_ = google::protobuf::Arena::CreateMessage<RouterGraph>(&arena_);
+        LoadRequiredSection(Section::ROUTER_GRAPH, router_graph_);
+    }
+    return *router_graph_;
+}
+
+const RoutesTable* Deserializer::GetRoutesTable() const {
+    if (is_legacy_format_ && !transport_catalogue_) {
+        LoadLegacyBase();
+    }
+    if (!is_routes_table_loaded_) {
+        auto* routes_table = google::protobuf::Arena::CreateMessage<RoutesTable>(&arena_);
+        if (LoadSection(Section::ROUTES_TABLE, routes_table)) {
+            routes_table_ = routes_table;
+        }
+        is_routes_table_loaded_ = true;
+    }
+    return routes_table_;
+}
 
 } // namespace serialization
 
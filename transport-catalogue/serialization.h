@@ -1,52 +1,132 @@
 #pragma once
 
 #include "json.h"
+#include "requests.h"
 #include "transport_catalogue.pb.h"
 #include "transport_router.h"
 
+#include <google/protobuf/arena.h>
+
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace serialization {
 
+using namespace std::literals;
+
+class Deserializer;
+
+inline constexpr std::string_view BASE_FORMAT_MAGIC = "TCBASE01"sv;
+
 class Serializer {
 public:
+    Serializer();
+    ~Serializer();
     
+    // Записи base_requests обрабатываются по мере чтения, документ целиком в памяти не хранится
     void SerializeFromInput(std::istream& input);
    
 private:
-    json::Document requests_;
-    std::vector<json::Node> base_requests_;
-    TransportCatalogue transport_catalogue_;
-    std::unordered_map<std::string, size_t> stopname_to_index_;
+    class InputHandler;
+    
+    struct PendingDistance {
+        uint32_t from;
+        std::string to;
+        int distance;
+    };
     
-    void SerializeStops();
-    void SerializeDistancesAndBuses();
+    // Корень входного документа без base_requests
+    json::Dict settings_;
+    std::vector<requests::BaseRecord> delayed_records_;
+    bool is_catalogue_started_ = false;
+    std::unique_ptr<Deserializer> previous_;
+    
+    google::protobuf::Arena arena_;
+    TransportCatalogue* transport_catalogue_;
+    RenderSettings* render_settings_;
+    RouterGraph* router_graph_;
+    RoutesTable* routes_table_ = nullptr;
+    
+    // Ключи ссылаются на имена в transport_catalogue_
+    std::unordered_map<std::string_view, size_t> stopname_to_index_;
+    std::unordered_map<std::string_view, Bus*> buses_;
+    std::map<std::pair<uint32_t, uint32_t>, FromToDistance*> distances_;
+    std::unordered_set<std::string> removed_stops_;
+    std::unordered_set<std::string> removed_buses_;
+    // Ссылки на остановки, описанные позже ссылающейся записи
+    std::vector<PendingDistance> pending_distances_;
+    std::unordered_map<Bus*, std::vector<std::string>> pending_bus_stops_;
+    
+    void AddSetting(const std::string& key, json::Node value);
+    void StartCatalogue();
+    void SerializeRecord(requests::BaseRecord record);
+    void SerializeStop(requests::StopRecord stop);
+    void SerializeBus(requests::BusRecord record);
+    uint32_t GetStopIndex(std::string_view stopname) const;
+    void ResolveStopReferences();
+    void RemoveBuses();
+    void RemoveStops();
+    void ComputeStopZoomLevels();
     
     void SerializeRenderSettings();
-    static Color ReadColor(const json::Node& color_node);
+    static void ReadColor(const json::Node& color_node, Color* result);
     
     void SerializeRoutingSettings();
-    void SerializeRouter();
-    static Graph SerializeGraph(const graph::DirectedWeightedGraph<double>& graph_usual);
-    static Edge SerializeEdge(const graph::Edge<double>& edge_usual);
-    static Router SerializeRouteInternalData(const transport_catalogue::TransportRouter& router_usual);
+    void SerializeRouter(const Deserializer* previous = nullptr);
+    static void SerializeGraph(const graph::DirectedWeightedGraph<double>& graph_usual, Graph* result);
+    static void SerializeEdge(const graph::Edge<double>& edge_usual, Edge* result);
+    static void SerializeRoutesTable(const transport_catalogue::TransportRouter& router_usual, RoutesTable* result);
+    std::string GetRoutingTableMode() const;
     
     using VertexUsual = transport_catalogue::TransportRouter::Vertex;
     void SerializeIdToVertex(const std::vector<VertexUsual>& id_to_vertex);
 
     template <typename IteratorRange>
-    static IncidenceList SerializeIncidenceList(IteratorRange range);
+    static void SerializeIncidenceList(IteratorRange range, IncidenceList* result);
     
     void SerializeToOstream() const;
 };
 
+class Deserializer {
+public:
+    explicit Deserializer(const std::string& file);
+    
+    const TransportCatalogue& GetTransportCatalogue() const;
+    const RenderSettings& GetRenderSettings() const;
+    const RouterGraph& GetRouterGraph() const;
+    // nullptr, если база собрана без матрицы маршрутов
+    const RoutesTable* GetRoutesTable() const;
+    
+private:
+    mutable std::ifstream input_;
+    mutable google::protobuf::Arena arena_;
+    std::unordered_map<int, Section> sections_;
+    std::streamoff sections_begin_ = 0;
+    bool is_legacy_format_ = false;
+    
+    mutable TransportCatalogue* transport_catalogue_ = nullptr;
+    mutable RenderSettings* render_settings_ = nullptr;
+    mutable RouterGraph* router_graph_ = nullptr;
+    mutable RoutesTable* routes_table_ = nullptr;
+    mutable bool is_routes_table_loaded_ = false;
+    
+    void ReadIndex();
+    // false, если раздела нет в индексе базы
+    bool LoadSection(Section::Type type, google::protobuf::Message* message) const;
+    void LoadRequiredSection(Section::Type type, google::protobuf::Message* message) const;
+    void LoadLegacyBase() const;
+};
+
 template <typename IncidenceListRange>
-IncidenceList Serializer::SerializeIncidenceList(IncidenceListRange range) {
-    IncidenceList result;
+void Serializer::SerializeIncidenceList(IncidenceListRange range, IncidenceList* result) {
     for (auto it = range.begin(); it != range.end(); ++it) {
-        result.add_edge_id(*it);
+        result->add_edge_id(*it);
     }
-    return result;
 }
 
 
@@ -68,7 +148,6 @@ IncidenceList SerializeIncidenceList(IteratorRange range);
 using VertexUsual = transport_catalogue::TransportRouter::Vertex;
 
 void SerializeIdToVertex(TransportCatalogue& tr, const std::vector<VertexUsual>& id_to_vertex);
-Router SerializeRouteInternalData(const transport_catalogue::TransportRouter& router_usual);
 
 
 
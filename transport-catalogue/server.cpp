@@ -0,0 +1,252 @@
+#include "server.h"
+#include "json_reader.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace server {
+
+namespace {
+
+constexpr size_t CHUNK_SIZE = 1 << 16;
+
+volatile sig_atomic_t is_stop_requested = 0;
+volatile sig_atomic_t is_reload_requested = 0;
+
+// Сигналы заблокированы все время, кроме ожидания ввода в ppoll: так документ
+// не прерывается посередине, а пришедший во время его обработки сигнал не теряется
+sigset_t wait_mask;
+
+void HandleSignal(int signal_number) {
+    if (signal_number == SIGHUP) {
+        is_reload_requested = 1;
+    } else {
+        is_stop_requested = 1;
+    }
+}
+
+void InstallSignalHandlers() {
+    struct sigaction action = {};
+    action.sa_handler = HandleSignal;
+    sigemptyset(&action.sa_mask);
+
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    for (int signal_number : {SIGTERM, SIGINT, SIGHUP}) {
+        sigaction(signal_number, &action, nullptr);
+        sigaddset(&blocked, signal_number);
+    }
+    sigprocmask(SIG_BLOCK, &blocked, &wait_mask);
+
+    // Ушедший клиент - ошибка записи, а не завершение процесса
+    signal(SIGPIPE, SIG_IGN);
+}
+
+void ThrowSystemError(const char* what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+// false - дескриптор не готов, потому что пришел сигнал
+bool WaitReadable(int fd) {
+    pollfd poll_fd = {fd, POLLIN, 0};
+    if (ppoll(&poll_fd, 1, nullptr, &wait_mask) < 0) {
+        if (errno == EINTR) {
+            return false;
+        }
+        ThrowSystemError("ppoll");
+    }
+    return true;
+}
+
+// false - читатель закрыл соединение
+bool WriteAll(int fd, string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EPIPE || errno == ECONNRESET) {
+                return false;
+            }
+            ThrowSystemError("write");
+        }
+        data.remove_prefix(written);
+    }
+    return true;
+}
+
+bool IsBlank(string_view line) {
+    return line.find_first_not_of(" \t\r") == string_view::npos;
+}
+
+} // namespace
+
+Server::Server(string base_file)
+    : base_file_(move(base_file)) {
+    LoadBase();
+}
+
+Server::~Server() = default;
+
+void Server::LoadBase() {
+    auto base = make_unique<serialization::Deserializer>(base_file_);
+    auto request_handler = make_unique<request_handler::RequestHandler>(*base);
+    request_handler->GetCatalogue();
+    request_handler->GetRenderer();
+    request_handler->GetRouter();
+
+    // Старый обработчик ссылается на старую базу и уходит раньше нее
+    request_handler_ = move(request_handler);
+    base_ = move(base);
+}
+
+void Server::ReloadIfRequested() {
+    if (!is_reload_requested) {
+        return;
+    }
+    is_reload_requested = 0;
+    try {
+        LoadBase();
+        cerr << "base reloaded: " << base_file_ << endl;
+    } catch (const exception& e) {
+        cerr << "base reload failed, keeping the previous one: " << e.what() << endl;
+    }
+}
+
+void Server::ServeStdio() {
+    InstallSignalHandlers();
+    ServeStream(STDIN_FILENO, STDOUT_FILENO);
+}
+
+void Server::ServeSocket(const string& socket_path) {
+    InstallSignalHandlers();
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("socket path is too long: " + socket_path);
+    }
+    memcpy(address.sun_path, socket_path.data(), socket_path.size());
+
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        ThrowSystemError("socket");
+    }
+    unlink(socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+        || listen(listen_fd, SOMAXCONN) < 0) {
+        const int error = errno;
+        close(listen_fd);
+        throw system_error(error, generic_category(), "bind " + socket_path);
+    }
+
+    try {
+        while (!is_stop_requested) {
+            ReloadIfRequested();
+            if (!WaitReadable(listen_fd)) {
+                continue;
+            }
+            const int client_fd = accept(listen_fd, nullptr, nullptr);
+            if (client_fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                ThrowSystemError("accept");
+            }
+            try {
+                ServeStream(client_fd, client_fd);
+            } catch (const system_error& e) {
+                cerr << "client dropped: " << e.what() << endl;
+            }
+            close(client_fd);
+        }
+    } catch (...) {
+        close(listen_fd);
+        unlink(socket_path.c_str());
+        throw;
+    }
+    close(listen_fd);
+    unlink(socket_path.c_str());
+}
+
+bool Server::ServeStream(int input_fd, int output_fd) {
+    vector<char> chunk(CHUNK_SIZE);
+    string buffer;
+    size_t line_begin = 0;
+    bool is_input_closed = false;
+
+    while (!is_input_closed) {
+        ReloadIfRequested();
+        if (is_stop_requested) {
+            return false;
+        }
+        if (!WaitReadable(input_fd)) {
+            continue;
+        }
+
+        buffer.erase(0, line_begin);
+        line_begin = 0;
+        const size_t size = buffer.size();
+        const ssize_t read_size = read(input_fd, chunk.data(), chunk.size());
+        if (read_size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("read");
+        }
+        buffer.append(chunk.data(), read_size);
+        is_input_closed = read_size == 0;
+
+        for (size_t line_end = buffer.find('\n', size); ; line_end = buffer.find('\n', line_begin)) {
+            if (line_end == string::npos) {
+                // Последняя строка может быть без перевода строки
+                if (!is_input_closed || line_begin == buffer.size()) {
+                    break;
+                }
+                line_end = buffer.size();
+            }
+            string document = buffer.substr(line_begin, line_end - line_begin);
+            line_begin = min(line_end + 1, buffer.size());
+            if (IsBlank(document)) {
+                continue;
+            }
+            if (!WriteAll(output_fd, ProcessDocument(move(document)))) {
+                return true;
+            }
+            if (is_stop_requested) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+string Server::ProcessDocument(string document) const {
+    ostringstream output;
+    try {
+        const json::FlatDocument requests = json::LoadFlat(move(document));
+        json_reader::ProcessStatRequests(requests.GetRoot().AsMap().at("stat_requests").AsArray(), *request_handler_, output,
+                                         json_reader::ReadOutputNumberFormat(requests.GetRoot().AsMap()));
+    } catch (const exception& e) {
+        // Ошибка в документе не останавливает сервер: клиент получает ее вместо ответа
+        output.str({});
+        json::Print(json::Builder{}.StartDict().Key("error_message").Value(e.what()).EndDict().Build(), output);
+    }
+    output << '\n';
+    return output.str();
+}
+
+} // namespace server
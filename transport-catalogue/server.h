@@ -0,0 +1,41 @@
+#pragma once
+
+#include "request_handler.h"
+#include "serialization.h"
+
+#include <memory>
+#include <string>
+
+namespace server {
+
+/*
+ * Режим serve: база и обработчик запросов загружаются один раз на все время работы.
+ * Каждая строка входа - документ со stat_requests, ответ на него - одна строка с массивом ответов.
+ * SIGTERM и SIGINT завершают работу после текущего документа, SIGHUP перечитывает базу
+ */
+class Server {
+public:
+    explicit Server(std::string base_file);
+    ~Server();
+
+    // Документы из stdin, ответы в stdout
+    void ServeStdio();
+
+    // Клиенты Unix-сокета обслуживаются по очереди, каждый - до конца своего потока
+    void ServeSocket(const std::string& socket_path);
+
+private:
+    std::string base_file_;
+    std::unique_ptr<serialization::Deserializer> base_;
+    std::unique_ptr<request_handler::RequestHandler> request_handler_;
+
+    // Новая база подменяет старую, только если загрузилась целиком
+    void LoadBase();
+    void ReloadIfRequested();
+
+    // false - пришел сигнал завершения
+    bool ServeStream(int input_fd, int output_fd);
+    std::string ProcessDocument(std::string document) const;
+};
+
+} // namespace server
@@ -1,5 +1,7 @@
 #include "svg.h"
 
+#include <array>
+#include <charconv>
 #include <map>
 #include <utility>
 
@@ -9,13 +11,126 @@ namespace svg {
 
 using namespace std::literals;
 
+namespace {
+
+constexpr auto MakeEscapeTable() {
+    std::array<string_view, 256> table{};
+    table['"'] = "&quot;"sv;
+    table['\''] = "&apos;"sv;
+    table['<'] = "&lt;"sv;
+    table['>'] = "&gt;"sv;
+    table['&'] = "&amp;"sv;
+    return table;
+}
+
+constexpr std::array<string_view, 256> XML_ESCAPES = MakeEscapeTable();
+
+constexpr string_view LINE_CAP_NAMES[] = {"butt"sv, "round"sv, "square"sv};
+constexpr string_view LINE_JOIN_NAMES[] = {"arcs"sv, "bevel"sv, "miter"sv, "miter-clip"sv, "round"sv};
+
+struct ColorWriter {
+    Writer& writer;
+    
+    void operator() (std::monostate) const {
+        writer.Write(NoneColor);
+    }
+    void operator() (const std::string& color) const {
+        writer.Write(color);
+    }
+    void operator() (Rgb rgb) const {
+        writer.Write("rgb("sv).WriteInteger(rgb.red).Write(","sv).WriteInteger(rgb.green).Write(","sv).WriteInteger(rgb.blue).Write(")"sv);
+    }
+    void operator() (Rgba rgba) const {
+        writer.Write("rgba("sv).WriteInteger(rgba.red).Write(","sv).WriteInteger(rgba.green).Write(","sv).WriteInteger(rgba.blue)
+            .Write(","sv).WriteNumber(rgba.opacity).Write(")"sv);
+    }
+};
+
+} // namespace
+
 void Object::Render(const RenderContext& context) const {
     context.RenderIndent();
 
     // Делегируем вывод тега своим подклассам
-    RenderObject(context);
+    Writer writer;
+    RenderObject(writer);
+
+    context.out << writer.GetText() << '\n';
+}
 
-    context.out << std::endl;
+// ---------- Writer ------------------
+
+Writer::Writer(numbers::Format number_format)
+    : number_format_(number_format) {
+}
+
+Writer& Writer::Write(string_view text) {
+    buffer_.append(text);
+    return *this;
+}
+
+Writer& Writer::WriteNumber(double value) {
+    char digits[numbers::MAX_LENGTH];
+    buffer_.append(digits, numbers::ToChars(value, number_format_, digits));
+    return *this;
+}
+
+Writer& Writer::WriteInteger(uint64_t value) {
+    char digits[24];
+    const auto result = to_chars(begin(digits), end(digits), value);
+    buffer_.append(digits, result.ptr);
+    return *this;
+}
+
+Writer& Writer::WriteColor(const Color& color) {
+    visit(ColorWriter{*this}, color);
+    return *this;
+}
+
+Writer& Writer::WriteLineCap(StrokeLineCap line_cap) {
+    return Write(LINE_CAP_NAMES[static_cast<int>(line_cap)]);
+}
+
+Writer& Writer::WriteLineJoin(StrokeLineJoin line_join) {
+    return Write(LINE_JOIN_NAMES[static_cast<int>(line_join)]);
+}
+
+Writer& Writer::WriteEscaped(string_view text) {
+    size_t begin = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        const string_view escape = XML_ESCAPES[static_cast<unsigned char>(text[i])];
+        if (escape.empty()) {
+            continue;
+        }
+        buffer_.append(text.substr(begin, i - begin)).append(escape);
+        begin = i + 1;
+    }
+    buffer_.append(text.substr(begin));
+    return *this;
+}
+
+Writer& Writer::StartDocument() {
+    return Write("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+                 "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\"300\" height=\"300\">\n"sv);
+}
+
+Writer& Writer::StartDocument(double width, double height) {
+    Write("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+          "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\""sv);
+    WriteNumber(width).Write("\" height=\""sv).WriteNumber(height);
+    return Write("\">\n"sv);
+}
+
+Writer& Writer::EndDocument() {
+    return Write("</svg>\n"sv);
+}
+
+const string& Writer::GetText() const {
+    return buffer_;
+}
+
+string Writer::ExtractText() {
+    return move(buffer_);
 }
 
 ostream& operator << (ostream& out, const StrokeLineCap& stroke_linecap) {
@@ -46,12 +161,11 @@ Circle& Circle::SetRadius(double radius)  {
     return *this;
 }
 
-void Circle::RenderObject(const RenderContext& context) const {
-    auto& out = context.out;
-    out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
-    out << "r=\""sv << radius_ << "\" "sv;
-    RenderAttrs(out);
-    out << "/>"sv;
+void Circle::RenderObject(Writer& writer) const {
+    writer.Write("<circle cx=\""sv).WriteNumber(center_.x).Write("\" cy=\""sv).WriteNumber(center_.y).Write("\" "sv);
+    writer.Write("r=\""sv).WriteNumber(radius_).Write("\" "sv);
+    RenderAttrs(writer);
+    writer.Write("/>"sv);
 }
 
 
@@ -63,22 +177,24 @@ Polyline& Polyline::AddPoint(Point point) {
     return *this;
 }
 
-void Polyline::RenderObject(const RenderContext& context) const  {
-    auto& out = context.out;
-    out << "<polyline points=\"";
-    size_t counter = 0;
-    size_t n = points_.size();
+Polyline& Polyline::ClearPoints() {
+    points_.clear();
+    return *this;
+}
+
+void Polyline::RenderObject(Writer& writer) const  {
+    writer.Write("<polyline points=\""sv);
+    bool is_first = true;
     for (const Point& point : points_) {
-        ++counter;
-        if (counter != n) {
-        out << point.x << "," << point.y << " ";
-        } else {
-            out << point.x << "," << point.y;
+        if (!is_first) {
+            writer.Write(" "sv);
         }
+        is_first = false;
+        writer.WriteNumber(point.x).Write(","sv).WriteNumber(point.y);
     }
-    out << "\" ";
-    RenderAttrs(out);
-    out << "/>";
+    writer.Write("\" "sv);
+    RenderAttrs(writer);
+    writer.Write("/>"sv);
 }
 
 // ---------- Text ------------------
@@ -118,32 +234,22 @@ Text& Text::SetData(std::string data) {
     return *this;
 }
 
-void Text::RenderObject(const RenderContext& context) const  {
-    auto& out = context.out;
-    out << "<text ";
-    RenderAttrs(out);
-    out << "x=" << "\"" << pos_.x << "\" " << "y=" << "\"" << pos_.y << "\" ";
-    out << "dx=" << "\"" << offset_.x << "\" " << "dy=" << "\"" << offset_.y << "\" ";
-    out << "font-size=" << "\"" << font_size_ << "\" ";
+void Text::RenderObject(Writer& writer) const  {
+    writer.Write("<text "sv);
+    RenderAttrs(writer);
+    writer.Write("x=\""sv).WriteNumber(pos_.x).Write("\" y=\""sv).WriteNumber(pos_.y).Write("\" "sv);
+    writer.Write("dx=\""sv).WriteNumber(offset_.x).Write("\" dy=\""sv).WriteNumber(offset_.y).Write("\" "sv);
+    writer.Write("font-size=\""sv).WriteInteger(font_size_).Write("\" "sv);
     if (!font_family_.empty()) {
-        out << "font-family=" << "\"" << font_family_ << "\" ";
+        writer.Write("font-family=\""sv).Write(font_family_).Write("\" "sv);
     }
     if (!font_weight_.empty()) {
-        out << "font-weight=" << "\"" << font_weight_ << "\">";
+        writer.Write("font-weight=\""sv).Write(font_weight_).Write("\">"sv);
     } else {
-        out << ">";
-    }
-    
-    const map<char, string> conversions = {{'"', "&quot;"}, {'\'', "&apos;"}, {'<', "&lt;"}, {'>', "&gt;"}, {'&', "&amp;"}};
-    
-    for (char c : data_) {
-        if (conversions.count(c) == 0) {
-            out << c;
-        } else {
-            out << conversions.at(c);
-        }
+        writer.Write(">"sv);
     }
-    out << "</text>";
+    writer.WriteEscaped(data_);
+    writer.Write("</text>"sv);
 }
 
 // ---------- Document ------------------
@@ -153,12 +259,13 @@ void Document::AddPtr(std::unique_ptr<Object>&& obj) {
 }
 
 void Document::Render(std::ostream& out) const {
-    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>" << endl;
-    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\"300\" height=\"300\">" << endl;
+    Writer writer;
+    writer.StartDocument();
     for (const auto& obj : objects_) {
-        obj->Render(out);
+        writer.Add(*obj);
     }
-    out << "</svg>" << endl;
+    writer.EndDocument();
+    out << writer.GetText();
 }
 
 }  // namespace svg
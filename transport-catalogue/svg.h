@@ -1,9 +1,12 @@
 #pragma once
 
+#include "number_format.h"
+
 #include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
 #include <optional>
@@ -57,6 +60,8 @@ struct RenderContext {
  * конкретных тегов SVG-документа
  * Реализует паттерн "Шаблонный метод" для вывода содержимого тега
  */
+class Writer;
+
 class Object {
 public:
     void Render(const RenderContext& context) const;
@@ -64,7 +69,9 @@ public:
     virtual ~Object() = default;
 
 private:
-    virtual void RenderObject(const RenderContext& context) const = 0;
+    friend class Writer;
+    
+    virtual void RenderObject(Writer& writer) const = 0;
 };
 
     
@@ -153,6 +160,43 @@ const std::map<StrokeLineJoin, std::string> strokelinejoin_to_string = {{StrokeL
 
 std::ostream& operator << (std::ostream& out, const StrokeLineJoin& stroke_linejoin);
 
+/*
+ * Пишет SVG в растущий строковый буфер: числа выводятся через to_chars, по умолчанию в том же
+ * виде, что и потоком, текст экранируется по таблице. Элементы нигде не хранятся - каждый
+ * сразу дописывается в буфер, поток не сбрасывается
+ */
+class Writer {
+public:
+    Writer() = default;
+    explicit Writer(numbers::Format number_format);
+    
+    Writer& Write(std::string_view text);
+    Writer& WriteNumber(double value);
+    Writer& WriteInteger(uint64_t value);
+    Writer& WriteColor(const Color& color);
+    Writer& WriteLineCap(StrokeLineCap line_cap);
+    Writer& WriteLineJoin(StrokeLineJoin line_join);
+    // Заменяет "'<>& сущностями XML
+    Writer& WriteEscaped(std::string_view text);
+    
+    // Заголовок и корневой тег, как в Document::Render
+    Writer& StartDocument();
+    // То же с настоящими размерами изображения
+    Writer& StartDocument(double width, double height);
+    Writer& EndDocument();
+    
+    // Элемент на отдельной строке. Для final-классов вызов RenderObject не виртуальный
+    template <typename Obj>
+    Writer& Add(const Obj& object);
+    
+    const std::string& GetText() const;
+    std::string ExtractText();
+    
+private:
+    std::string buffer_;
+    numbers::Format number_format_;
+};
+
 template <typename Owner>
 class PathProps {
 public:
@@ -184,7 +228,7 @@ public:
     virtual ~PathProps() = default;
 
 protected:
-    void RenderAttrs(std::ostream& out) const;
+    void RenderAttrs(Writer& writer) const;
     
 private:
     std::optional<Color> fill_color_;
@@ -199,22 +243,22 @@ private:
 };
     
 template <typename Owner>
-void PathProps<Owner>::RenderAttrs(std::ostream& out) const {
+void PathProps<Owner>::RenderAttrs(Writer& writer) const {
 
     if (fill_color_) {
-        out << "fill=\"" << *fill_color_ << "\" ";
+        writer.Write("fill=\"").WriteColor(*fill_color_).Write("\" ");
     }
     if (stroke_color_) {
-        out << "stroke=\"" << *stroke_color_ << "\" ";
+        writer.Write("stroke=\"").WriteColor(*stroke_color_).Write("\" ");
     }
     if (stroke_width_) {
-        out << "stroke-width=\"" << *stroke_width_ << "\" ";
+        writer.Write("stroke-width=\"").WriteNumber(*stroke_width_).Write("\" ");
     }
     if (stroke_linecap_) {
-        out << "stroke-linecap=\"" << *stroke_linecap_ << "\" ";
+        writer.Write("stroke-linecap=\"").WriteLineCap(*stroke_linecap_).Write("\" ");
     }
     if (stroke_linejoin_) {
-        out << "stroke-linejoin=\"" << *stroke_linejoin_ << "\" ";
+        writer.Write("stroke-linejoin=\"").WriteLineJoin(*stroke_linejoin_).Write("\" ");
     }
 }
     
@@ -228,7 +272,9 @@ public:
     Circle& SetRadius(double radius);
 
 private:
-    void RenderObject(const RenderContext& context) const override;
+    friend class Writer;
+    
+    void RenderObject(Writer& writer) const override;
 
     Point center_;
     double radius_ = 1.0;
@@ -238,12 +284,17 @@ private:
  * Класс Polyline моделирует элемент <polyline> для отображения ломаных линий
  * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/polyline
  */
-class Polyline : public Object, public PathProps<Polyline> {
+class Polyline final : public Object, public PathProps<Polyline> {
 public:
     Polyline& AddPoint(Point point);
+    
+    // Точки убираются, атрибуты остаются: одна ломаная переиспользуется для многих маршрутов
+    Polyline& ClearPoints();
 
 private:
-    void RenderObject(const RenderContext& context) const override;
+    friend class Writer;
+    
+    void RenderObject(Writer& writer) const override;
     
     std::vector<Point> points_;
 };
@@ -252,7 +303,7 @@ private:
  * Класс Text моделирует элемент <text> для отображения текста
  * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/text
  */
-class Text : public Object, public PathProps<Text> {
+class Text final : public Object, public PathProps<Text> {
 public:
     // Задаёт координаты опорной точки (атрибуты x и y)
     Text& SetPosition(Point pos);
@@ -273,7 +324,9 @@ public:
     Text& SetData(std::string data);
     
 private:
-    void RenderObject(const RenderContext& context) const override ;
+    friend class Writer;
+    
+    void RenderObject(Writer& writer) const override;
 
     Point pos_;
     Point offset_;
@@ -294,6 +347,13 @@ private:
     std::vector<std::unique_ptr<Object>> objects_;
 };
     
+template <typename Obj>
+Writer& Writer::Add(const Obj& object) {
+    object.RenderObject(*this);
+    buffer_.push_back('\n');
+    return *this;
+}
+
 template <typename Obj>
 void ObjectContainer::Add(Obj obj) {
     auto ptr = std::make_unique<Obj> (std::move(obj));
@@ -0,0 +1,160 @@
+#include "json_builder.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using namespace std;
+using namespace std::literals;
+
+namespace {
+
+// Счётчики глобального operator new: сколько раз и сколько байт выделено
+size_t allocation_count = 0;
+size_t allocated_bytes = 0;
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    allocated_bytes += size;
+    if (void* pointer = malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+namespace {
+
+void Check(bool condition, string_view message) {
+    if (!condition) {
+        cerr << "FAILED: "sv << message << endl;
+        exit(1);
+    }
+}
+
+struct Allocations {
+    size_t count;
+    size_t bytes;
+};
+
+template <typename Function>
+Allocations CountAllocations(Function function) {
+    const size_t count_before = allocation_count;
+    const size_t bytes_before = allocated_bytes;
+    function();
+    return {allocation_count - count_before, allocated_bytes - bytes_before};
+}
+
+// Ответ на запрос Route: элементы Wait и Bus по очереди. Имена длиннее буфера короткой строки,
+// чтобы каждое лишнее копирование было видно по числу выделений
+string MakeStopName(size_t index) {
+    return "Stop with a long enough name "s + to_string(index);
+}
+
+json::Node BuildRouteResponse(size_t item_count) {
+    json::Builder builder;
+    auto items = builder.StartDict()
+        .Key("request_id"s).Value(1)
+        .Key("total_time"s).Value(item_count * 1.5)
+        .Key("items"s).StartArray();
+    for (size_t i = 0; i < item_count; ++i) {
+        if (i % 2 == 0) {
+            items.StartDict()
+                .Key("type"s).Value("Wait"s)
+                .Key("stop_name"s).Value(MakeStopName(i))
+                .Key("time"s).Value(6)
+                .EndDict();
+        } else {
+            items.StartDict()
+                .Key("type"s).Value("Bus"s)
+                .Key("bus"s).Value(MakeStopName(i))
+                .Key("span_count"s).Value(3)
+                .Key("time"s).Value(i * 0.5)
+                .EndDict();
+        }
+    }
+    items.EndArray().EndDict();
+    return builder.Build();
+}
+
+// Тот же ответ, собранный без Builder: нижняя граница числа выделений
+json::Node MakeRouteResponse(size_t item_count) {
+    json::Array items;
+    for (size_t i = 0; i < item_count; ++i) {
+        json::Dict item;
+        if (i % 2 == 0) {
+            item.emplace("type"s, "Wait"s);
+            item.emplace("stop_name"s, MakeStopName(i));
+            item.emplace("time"s, 6);
+        } else {
+            item.emplace("type"s, "Bus"s);
+            item.emplace("bus"s, MakeStopName(i));
+            item.emplace("span_count"s, 3);
+            item.emplace("time"s, i * 0.5);
+        }
+        items.emplace_back(move(item));
+    }
+    json::Dict response;
+    response.emplace("request_id"s, 1);
+    response.emplace("total_time"s, item_count * 1.5);
+    response.emplace("items"s, move(items));
+    return response;
+}
+
+// Собранный Builder ответ не копирует элементы: выделений столько же, сколько при ручной сборке,
+// с запасом на рост стеков и массивов. Поэтому их число растёт линейно с числом элементов
+void TestRouteResponseIsAllocationLinear() {
+    double previous_per_item = 0;
+    for (size_t item_count : {1000, 4000, 16000}) {
+        json::Node built, made;
+        const Allocations builder_allocations = CountAllocations([&] { built = BuildRouteResponse(item_count); });
+        const Allocations direct_allocations = CountAllocations([&] { made = MakeRouteResponse(item_count); });
+        Check(built == made, "Builder produced a different response"sv);
+
+        const double per_item = 1.0 * builder_allocations.count / item_count;
+        cout << item_count << " items: "sv << builder_allocations.count << " allocations via Builder, "sv
+             << direct_allocations.count << " without it ("sv << per_item << " per item)"sv << endl;
+        Check(builder_allocations.count <= direct_allocations.count + 64,
+              "Builder allocates more than building the response directly"sv);
+        if (previous_per_item > 0) {
+            Check(per_item <= previous_per_item * 1.05, "allocations grow faster than the number of items"sv);
+        }
+        previous_per_item = per_item;
+    }
+}
+
+// Строка карты переходит в ответ без копии
+void TestMapStringIsMoved() {
+    const size_t map_size = 4 << 20;
+    string map(map_size, 'x');
+    json::Node response;
+    const Allocations allocations = CountAllocations([&] {
+        response = json::Builder{}.StartDict()
+            .Key("map"s).Value(move(map))
+            .Key("request_id"s).Value(1)
+        .EndDict().Build();
+    });
+    cout << "map response: "sv << allocations.count << " allocations, "sv << allocations.bytes << " bytes"sv << endl;
+    Check(response.AsMap().at("map"s).AsString().size() == map_size, "map string is lost"sv);
+    Check(allocations.bytes < map_size / 4, "map string is copied"sv);
+}
+
+} // namespace
+
+int main() {
+    TestRouteResponseIsAllocationLinear();
+    TestMapStringIsMoved();
+    cout << "json_builder_allocation_test: OK"sv << endl;
+}
@@ -0,0 +1,197 @@
+#include "transport_router.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace std::literals;
+using transport_catalogue::TransportCatalogue;
+using transport_catalogue::TransportRouter;
+
+namespace {
+
+const double EPSILON = 1e-6;
+
+void Check(bool condition, string_view message) {
+    if (!condition) {
+        cerr << "FAILED: "sv << message << endl;
+        exit(1);
+    }
+}
+
+struct BusDescription {
+    string name;
+    vector<string> stops;
+    bool is_roundtrip;
+};
+
+// Случайная сеть: остановки, расстояния между любыми двумя и автобусы base_buses.
+// Автобусы added_buses дельта добавляет к уже построенной сети
+struct Network {
+    vector<string> stopnames;
+    vector<vector<int>> distances;
+    vector<BusDescription> base_buses;
+    vector<BusDescription> added_buses;
+};
+
+BusDescription MakeBus(string name, const vector<string>& stopnames, size_t max_stop_count, mt19937& generator) {
+    uniform_int_distribution<size_t> stop_distribution(0, stopnames.size() - 1);
+    uniform_int_distribution<size_t> count_distribution(2, max_stop_count);
+    BusDescription bus{move(name), {}, bernoulli_distribution(0.3)(generator)};
+    const size_t stop_count = count_distribution(generator);
+    for (size_t i = 0; i < stop_count; ++i) {
+        bus.stops.push_back(stopnames[stop_distribution(generator)]);
+    }
+    if (bus.is_roundtrip) {
+        bus.stops.push_back(bus.stops.front());
+    }
+    return bus;
+}
+
+Network MakeNetwork(unsigned seed, size_t stop_count, size_t base_bus_count, size_t added_bus_count, size_t max_added_stop_count) {
+    mt19937 generator(seed);
+    uniform_int_distribution<int> distance_distribution(100, 5000);
+    Network network;
+    for (size_t i = 0; i < stop_count; ++i) {
+        network.stopnames.push_back("Stop"s + to_string(i));
+    }
+    network.distances.assign(stop_count, vector<int>(stop_count));
+    for (auto& row : network.distances) {
+        for (int& distance : row) {
+            distance = distance_distribution(generator);
+        }
+    }
+    for (size_t i = 0; i < base_bus_count; ++i) {
+        network.base_buses.push_back(MakeBus("Base"s + to_string(i), network.stopnames, 6, generator));
+    }
+    for (size_t i = 0; i < added_bus_count; ++i) {
+        network.added_buses.push_back(MakeBus("Added"s + to_string(i), network.stopnames, max_added_stop_count, generator));
+    }
+    return network;
+}
+
+void FillCatalogue(const Network& network, TransportCatalogue& catalogue) {
+    catalogue.SetBusWaitTime(6);
+    catalogue.SetBusVelocity(40);
+    for (size_t i = 0; i < network.stopnames.size(); ++i) {
+        catalogue.AddStop(network.stopnames[i], {43.5 + 0.01 * i, 39.7});
+    }
+    for (size_t from = 0; from < network.stopnames.size(); ++from) {
+        for (size_t to = 0; to < network.stopnames.size(); ++to) {
+            catalogue.SetDistanceBetweenStops(network.stopnames[from], network.stopnames[to], network.distances[from][to]);
+        }
+    }
+    for (const BusDescription& bus : network.base_buses) {
+        catalogue.AddBus(bus.name, bus.stops, bus.is_roundtrip);
+    }
+}
+
+void AddBuses(const Network& network, TransportCatalogue& catalogue) {
+    for (const BusDescription& bus : network.added_buses) {
+        catalogue.AddBus(bus.name, bus.stops, bus.is_roundtrip);
+    }
+}
+
+// Маршрут - цепочка рёбер графа своего роутера от остановки from к остановке to с суммарным весом weight
+void CheckRouteEdges(const TransportRouter& router, const graph::Router<double>::RouteInfo& route,
+                     string_view from, string_view to, string_view name) {
+    const auto& graph = router.GetGraph();
+    const auto& id_to_vertex = router.GetIdToVertex();
+    double weight = 0;
+    string_view current = from;
+    bool is_waiting = true;
+    for (graph::EdgeId edge_id : route.edges) {
+        const auto& edge = graph.GetEdge(edge_id);
+        Check(id_to_vertex[edge.from].stopname == current && id_to_vertex[edge.from].is_waiting == is_waiting,
+              string(name) + ": route edges are not chained"s);
+        current = id_to_vertex[edge.to].stopname;
+        is_waiting = id_to_vertex[edge.to].is_waiting;
+        weight += edge.weight;
+    }
+    Check(current == to && is_waiting, string(name) + ": route does not end at the destination"s);
+    Check(abs(weight - route.weight) < EPSILON, string(name) + ": route weight differs from the sum of its edges"s);
+}
+
+// Обновлённая матрица должна давать те же веса маршрутов, что и построенная заново
+void CheckSameRoutes(const Network& network, const TransportRouter& expected, const TransportRouter& actual, string_view name) {
+    for (const string& from : network.stopnames) {
+        for (const string& to : network.stopnames) {
+            const auto expected_route = expected.BuildRoute(from, to);
+            const auto actual_route = actual.BuildRoute(from, to);
+            const string pair_name = string(name) + " "s + from + " -> "s + to;
+            Check(expected_route.has_value() == actual_route.has_value(), pair_name + ": reachability differs"s);
+            if (!expected_route) {
+                continue;
+            }
+            Check(abs(expected_route->weight - actual_route->weight) < EPSILON, pair_name + ": weight differs"s);
+            CheckRouteEdges(actual, *actual_route, from, to, pair_name);
+        }
+    }
+}
+
+// Автобусы добавляются в уже построенную сеть через TransportRouter::AddBus
+void TestAddBus(const Network& network) {
+    TransportCatalogue catalogue;
+    FillCatalogue(network, catalogue);
+    TransportRouter router(catalogue);
+    router.BuildRouter();
+    AddBuses(network, catalogue);
+    for (const BusDescription& bus : network.added_buses) {
+        router.AddBus(catalogue.GetBus(bus.name));
+    }
+
+    TransportRouter rebuilt(catalogue);
+    rebuilt.BuildRouter();
+    CheckSameRoutes(network, rebuilt, router, "AddBus"sv);
+}
+
+// Неизвестная остановка не добавляется в граф и не находит маршрута
+void TestUnknownStop(const Network& network) {
+    TransportCatalogue catalogue;
+    FillCatalogue(network, catalogue);
+    TransportRouter router(catalogue);
+    Check(!router.BuildRoute(network.stopnames.front(), ""sv), "route to an empty stop name"sv);
+    Check(!router.BuildRoute("Unknown"sv, network.stopnames.front()), "route from an unknown stop"sv);
+    Check(router.GetIdToVertex().size() == 2 * network.stopnames.size(), "unknown stop added to the graph"sv);
+}
+
+// Дельта make_base, только добавляющая автобусы: матрица строится от матрицы предыдущей базы
+void TestBuildRouterFrom(const Network& network) {
+    TransportCatalogue previous_catalogue;
+    FillCatalogue(network, previous_catalogue);
+    TransportRouter previous(previous_catalogue);
+    previous.BuildRouter();
+
+    TransportCatalogue catalogue;
+    FillCatalogue(network, catalogue);
+    AddBuses(network, catalogue);
+    TransportRouter router(catalogue);
+    router.BuildRouterFrom(previous);
+
+    TransportRouter rebuilt(catalogue);
+    rebuilt.BuildRouter();
+    CheckSameRoutes(network, rebuilt, router, "BuildRouterFrom"sv);
+}
+
+} // namespace
+
+int main() {
+    for (unsigned seed = 1; seed <= 20; ++seed) {
+        // Короткие добавленные автобусы - дельта дополняется вставкой рёбер,
+        // длинные - пересчётом затронутых строк
+        const Network small_delta = MakeNetwork(seed, 30, 12, 1, 2);
+        TestAddBus(small_delta);
+        TestBuildRouterFrom(small_delta);
+
+        const Network large_delta = MakeNetwork(seed, 40, 10, 5, 8);
+        TestAddBus(large_delta);
+        TestBuildRouterFrom(large_delta);
+    }
+    TestUnknownStop(MakeNetwork(1, 10, 3, 0, 2));
+    cout << "transport_router_test: OK"sv << endl;
+}
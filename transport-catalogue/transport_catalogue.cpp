@@ -22,7 +22,8 @@ TransportCatalogue::TransportCatalogue(const serialization::TransportCatalogue&
         for (size_t k = 0; k < tr_ser.bus(i).stop_index_size(); ++k) {
             stops.push_back(all_stops[tr_ser.bus(i).stop_index(k)].name);
         }
-        AddBus(tr_ser.bus(i).name(), stops, tr_ser.bus(i).is_roundtrip());
+        AddBus(tr_ser.bus(i).name(), stops, tr_ser.bus(i).is_roundtrip(),
+               {tr_ser.bus(i).stop_zoom().begin(), tr_ser.bus(i).stop_zoom().end()});
     }
     
     bus_wait_time_ = tr_ser.bus_wait_time();
@@ -32,15 +33,16 @@ TransportCatalogue::TransportCatalogue(const serialization::TransportCatalogue&
 void TransportCatalogue::AddStop(string_view stop, const Coordinates& coordinates) {
     
     string stop_name(stop);
-    all_stops_.push_back({stop_name, coordinates});
+    all_stops_.push_back({stop_name, coordinates, all_stops_.size()});
     stopname_to_stop_[all_stops_.back().name] = &(all_stops_.back());
     stop_to_buses_[&(all_stops_.back())];
 }
 
-void TransportCatalogue::AddBus(string_view bus, const vector<string>& stops, bool is_roundtrip) {
+void TransportCatalogue::AddBus(string_view bus, const vector<string>& stops, bool is_roundtrip,
+                                vector<uint8_t> stop_zoom_levels) {
     
     string bus_name(bus);
-    all_buses_.push_back({bus_name, {}, is_roundtrip});
+    all_buses_.push_back({bus_name, {}, is_roundtrip, move(stop_zoom_levels), all_buses_.size()});
     all_buses_.back().stops.reserve(stops.size());
     for (const string& stop : stops) {
         all_buses_.back().stops.push_back(stopname_to_stop_[stop]);
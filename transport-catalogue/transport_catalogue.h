@@ -29,7 +29,8 @@ public:
     TransportCatalogue(const serialization::TransportCatalogue& tr_ser);
     
     void AddStop(std::string_view stop, const geo::Coordinates& coordinates);
-    void AddBus(std::string_view bus, const std::vector<std::string>& stops, bool is_roundtrip);
+    void AddBus(std::string_view bus, const std::vector<std::string>& stops, bool is_roundtrip,
+                std::vector<uint8_t> stop_zoom_levels = {});
     
     void SetDistanceBetweenStops(std::string_view from, std::string_view to, int distance);
     
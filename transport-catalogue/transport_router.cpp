@@ -3,6 +3,8 @@
 #include <optional>
 #include <cmath>
 #include <iostream>
+#include <deque>
+#include <tuple>
 
 using namespace std;
 using namespace graph;
@@ -10,31 +12,31 @@ using namespace graph;
 namespace transport_catalogue {
 
 TransportRouter::TransportRouter(const TransportCatalogue& transport_catalogue)
-    : transport_catalogue_(transport_catalogue)
+    : transport_catalogue_(&transport_catalogue)
 {
     
 }
 
 
-TransportRouter::TransportRouter(const serialization::TransportCatalogue& transport_catalogue, const TransportCatalogue& transport_catalogue_usual)
-    : transport_catalogue_(transport_catalogue_usual),
-      graph_(SetGraph(transport_catalogue.router().graph())),
-      router_(SetRouter(transport_catalogue.router()))
+TransportRouter::TransportRouter(const serialization::RouterGraph& router_graph, const serialization::RoutesTable* routes_table)
+    : router_(SetRouter(routes_table)),
+      graph_(SetGraph(router_graph.graph()))
 {
-    SetIdToVertex(transport_catalogue);
+    SetIdToVertex(router_graph);
     SetVertexToId();
     is_graph_built_ = true;
+    is_router_built_ = router_ != nullptr;
 }
 
 
 optional<graph::Router<double>::RouteInfo> TransportRouter::BuildRoute(string_view from, string_view to) const {
-    if (!is_graph_built_) {
-        BuildGraph();
-        router_ = make_unique<Router<double>> (graph_);
-        is_graph_built_ = true;
+    BuildRouter();
+    auto it_from = vertex_to_id_.find({string(from), true});
+    auto it_to = vertex_to_id_.find({string(to), true});
+    if (it_from == vertex_to_id_.end() || it_to == vertex_to_id_.end()) {
+        return nullopt;
     }
-    Vertex vertex_from{string(from), true}, vertex_to{string(to), true};
-    return router_->BuildRoute(vertex_to_id_[vertex_from], vertex_to_id_[vertex_to]);
+    return router_->BuildRoute(it_from->second, it_to->second);
 }
 
 const graph::DirectedWeightedGraph<double>& TransportRouter::GetGraph() const {
@@ -54,13 +56,13 @@ void TransportRouter::BuildGraph() const {
     if (is_graph_built_) {
         return;
     }
-    vector<StopPtr> all_stops(transport_catalogue_.GetAllStops());
+    vector<StopPtr> all_stops(transport_catalogue_->GetAllStops());
     graph_ = DirectedWeightedGraph<double> (2 * all_stops.size());
     
     id_to_vertex_.reserve(2 * all_stops.size());
     AddVertexes(all_stops);
     
-    vector<BusPtr> all_buses(transport_catalogue_.GetAllBuses());
+    vector<BusPtr> all_buses(transport_catalogue_->GetAllBuses());
     for (const BusPtr& bus : all_buses) {
         AddEdgesForBus(bus);
     }
@@ -79,6 +81,130 @@ void TransportRouter::BuildRouter() const {
     is_router_built_ = true;
 }
     
+void TransportRouter::AddBus(const BusPtr& bus) const {
+    if (!transport_catalogue_) {
+        throw logic_error("transport catalogue is required to add a bus");
+    }
+    BuildRouter();
+    const EdgeId first_new_edge = graph_.GetEdgeCount();
+    AddEdgesForBus(bus);
+    for (EdgeId edge_id = first_new_edge; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        router_->AddEdge(edge_id);
+    }
+}
+
+void TransportRouter::BuildRouterFrom(const TransportRouter& previous) const {
+    if (is_router_built_) {
+        return;
+    }
+    BuildGraph();
+    const Router<double>* previous_router = previous.GetRouter();
+    if (!previous_router) {
+        BuildRouter();
+        return;
+    }
+    
+    const size_t vertex_count = graph_.GetVertexCount();
+    const auto& previous_graph = previous.GetGraph();
+    const auto& previous_routes = previous_router->GetRoutesInternalData();
+    
+    vector<optional<VertexId>> vertex_map(previous_graph.GetVertexCount());
+    for (VertexId vertex = 0; vertex < vertex_map.size(); ++vertex) {
+        auto it = vertex_to_id_.find(previous.GetIdToVertex()[vertex]);
+        if (it != vertex_to_id_.end()) {
+            vertex_map[vertex] = it->second;
+        }
+    }
+    
+    // Рёбра с совпадающими концами, автобусом, числом пролётов и весом считаем неизменившимися
+    using EdgeKey = tuple<VertexId, VertexId, string_view, size_t, double>;
+    map<EdgeKey, deque<EdgeId>> edges_by_key;
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        edges_by_key[{edge.from, edge.to, edge.busname, edge.stop_count, edge.weight}].push_back(edge_id);
+    }
+    vector<optional<EdgeId>> edge_map(previous_graph.GetEdgeCount());
+    for (EdgeId edge_id = 0; edge_id < edge_map.size(); ++edge_id) {
+        const auto& edge = previous_graph.GetEdge(edge_id);
+        if (!vertex_map[edge.from] || !vertex_map[edge.to]) {
+            continue;
+        }
+        auto it = edges_by_key.find({*vertex_map[edge.from], *vertex_map[edge.to], edge.busname, edge.stop_count, edge.weight});
+        if (it == edges_by_key.end() || it->second.empty()) {
+            continue;
+        }
+        edge_map[edge_id] = it->second.front();
+        it->second.pop_front();
+    }
+    vector<EdgeId> added_edges;
+    for (const auto& [key, edge_ids] : edges_by_key) {
+        added_edges.insert(added_edges.end(), edge_ids.begin(), edge_ids.end());
+    }
+    
+    Router<double>::RoutesInternalData routes(vertex_count, vector<optional<Router<double>::RouteInternalData>>(vertex_count));
+    vector<bool> is_row_intact(vertex_count, false);
+    vector<bool> is_row_valid(vertex_count, false);
+    
+    for (VertexId previous_from = 0; previous_from < previous_routes.size(); ++previous_from) {
+        if (!vertex_map[previous_from]) {
+            continue;
+        }
+        const VertexId from = *vertex_map[previous_from];
+        auto& routes_from = routes[from];
+        bool is_intact = true;
+        for (VertexId previous_to = 0; previous_to < previous_routes.size(); ++previous_to) {
+            const auto& route = previous_routes[previous_from][previous_to];
+            if (!route || !vertex_map[previous_to]) {
+                continue;
+            }
+            if (route->prev_edge && !edge_map[*route->prev_edge]) {
+                is_intact = false;
+                break;
+            }
+            routes_from[*vertex_map[previous_to]] = Router<double>::RouteInternalData{
+                route->weight, route->prev_edge ? edge_map[*route->prev_edge] : nullopt};
+        }
+        is_row_intact[from] = is_intact;
+        // Новое ребро, сокращающее какой-либо маршрут из строки, также требует её пересчёта
+        bool is_valid = is_intact;
+        for (EdgeId edge_id : added_edges) {
+            if (!is_valid) {
+                break;
+            }
+            const auto& edge = graph_.GetEdge(edge_id);
+            const auto& route_to_edge = routes_from[edge.from];
+            const auto& route_through_edge = routes_from[edge.to];
+            if (route_to_edge && (!route_through_edge || route_to_edge->weight + edge.weight < route_through_edge->weight)) {
+                is_valid = false;
+            }
+        }
+        is_row_valid[from] = is_valid;
+    }
+    
+    // Если рёбра только добавлялись, вместо пересчёта строк можно дополнить матрицу
+    // каждым новым ребром за O(V^2) - выбираем то, что дешевле
+    const bool is_only_added = all_of(edge_map.begin(), edge_map.end(), [] (const auto& edge_id) { return edge_id.has_value(); })
+        && all_of(is_row_intact.begin(), is_row_intact.end(), [] (bool is_intact) { return is_intact; });
+    const double invalid_row_count = count(is_row_valid.begin(), is_row_valid.end(), false);
+    const double recompute_cost = invalid_row_count * graph_.GetEdgeCount() * log2(vertex_count + 1.0);
+    const double insert_cost = 1.0 * added_edges.size() * vertex_count * vertex_count;
+    
+    router_ = make_unique<Router<double>> (graph_, move(routes));
+    if (is_only_added && insert_cost < recompute_cost) {
+        sort(added_edges.begin(), added_edges.end());
+        for (EdgeId edge_id : added_edges) {
+            router_->AddEdge(edge_id);
+        }
+    } else {
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            if (!is_row_valid[vertex]) {
+                router_->RecomputeRoutesFrom(vertex);
+            }
+        }
+    }
+    is_router_built_ = true;
+}
+    
 void TransportRouter::AddVertexes(const vector<StopPtr>& all_stops) const {
     for (const StopPtr& stop : all_stops) {
         vertex_to_id_[{stop->name, true}] = id_to_vertex_.size();
@@ -89,8 +215,8 @@ void TransportRouter::AddVertexes(const vector<StopPtr>& all_stops) const {
 }
 
 void TransportRouter::AddEdgesForBus(const BusPtr& bus) const {
-    double wait_time = transport_catalogue_.GetWaitTimeAndVelocity().first;
-    double velocity = (transport_catalogue_.GetWaitTimeAndVelocity().second) * 1000.0 / 60;
+    double wait_time = transport_catalogue_->GetWaitTimeAndVelocity().first;
+    double velocity = (transport_catalogue_->GetWaitTimeAndVelocity().second) * 1000.0 / 60;
     
     vector<StopPtr> stops(bus->stops);
     
@@ -112,16 +238,17 @@ void TransportRouter::AddEdgesBetweenStops(const std::vector<StopPtr>& stops, co
     for (size_t i = 0; i < stops.size(); ++i) {
         double distance = 0;
         for (size_t j = i + 1; j < stops.size(); ++j) {
-            distance += transport_catalogue_.GetDistanceBetweenStops(stops[j - 1]->name, stops[j]->name);
+            distance += transport_catalogue_->GetDistanceBetweenStops(stops[j - 1]->name, stops[j]->name);
             graph_.AddEdge({vertex_to_id_.at({stops[i]->name, false}), vertex_to_id_.at({stops[j]->name, true}), distance / velocity, bus->name, j - i});
         }
     }
 }
 
 
-void TransportRouter::SetIdToVertex(const serialization::TransportCatalogue& transport_catalogue) const {
-    for (size_t i = 0; i < transport_catalogue.id_to_vertex_size(); ++i) {
-        id_to_vertex_.push_back({transport_catalogue.id_to_vertex(i).stopname(), transport_catalogue.id_to_vertex(i).is_waiting()});
+void TransportRouter::SetIdToVertex(const serialization::RouterGraph& router_graph) const {
+    id_to_vertex_.reserve(router_graph.id_to_vertex_size());
+    for (size_t i = 0; i < router_graph.id_to_vertex_size(); ++i) {
+        id_to_vertex_.push_back({router_graph.id_to_vertex(i).stopname(), router_graph.id_to_vertex(i).is_waiting()});
     }
 }
 
@@ -154,31 +281,39 @@ graph::DirectedWeightedGraph<double> TransportRouter::SetGraph(const serializati
     return graph::DirectedWeightedGraph<double> (edges, incidence_lists);
 }
 
-unique_ptr<graph::Router<double>> TransportRouter::SetRouter(const serialization::Router& router) const {
+unique_ptr<graph::Router<double>> TransportRouter::SetRouter(const serialization::RoutesTable* routes_table) const {
+    if (!routes_table) {
+        return nullptr;
+    }
+    return make_unique<graph::Router<double>> (graph_, SetRoutesTable(*routes_table));
+}
+
+graph::Router<double>::RoutesInternalData TransportRouter::SetRoutesTable(const serialization::RoutesTable& routes_table) const {
+    
+    const size_t vertex_count = routes_table.vertex_count();
+    if (static_cast<size_t>(routes_table.weight_size()) != vertex_count * vertex_count
+        || static_cast<size_t>(routes_table.prev_edge_size()) != vertex_count * vertex_count) {
+        throw invalid_argument("corrupted routes table");
+    }
     
-    using OptionalRouteInternalData = optional<graph::Router<double>::RouteInternalData>;
-    vector<vector<OptionalRouteInternalData>> route_internal_data;
+    graph::Router<double>::RoutesInternalData route_internal_data(vertex_count, vector<optional<graph::Router<double>::RouteInternalData>>(vertex_count));
     
-    for (size_t i = 0; i < router.route_internal_data_list_size(); ++i) {
-        vector<OptionalRouteInternalData> route_internal_data_list_tmp;
-        for (size_t k = 0; k < router.route_internal_data_list(i).route_internal_data_size(); ++k) {
-            OptionalRouteInternalData tmp = make_optional<graph::Router<double>::RouteInternalData> ();
-            tmp.value().weight = router.route_internal_data_list(i).route_internal_data(k).weight();
-            tmp.value().prev_edge = make_optional<size_t> (-1);
-            if (tmp->weight < 0) {
-                route_internal_data_list_tmp.push_back(nullopt);
+    size_t cell = 0;
+    for (auto& route_internal_data_list : route_internal_data) {
+        for (auto& internal_data : route_internal_data_list) {
+            const double weight = routes_table.weight(cell);
+            const uint32_t prev_edge = routes_table.prev_edge(cell);
+            ++cell;
+            if (weight < 0) {
                 continue;
             }
-            if (router.route_internal_data_list(i).route_internal_data(k).is_prev_edge()) {
-                tmp->prev_edge = make_optional<size_t> (router.route_internal_data_list(i).route_internal_data(k).prev_edge());
-            } else {
-                tmp->prev_edge = nullopt;
+            internal_data = graph::Router<double>::RouteInternalData{weight, nullopt};
+            if (prev_edge > 0) {
+                internal_data->prev_edge = prev_edge - 1;
             }
-            route_internal_data_list_tmp.push_back(tmp);
         }
-        route_internal_data.push_back(route_internal_data_list_tmp);
     }
-   return make_unique<graph::Router<double>> (graph_, route_internal_data);
+    return route_internal_data;
 }
 
 
@@ -12,7 +12,7 @@ class TransportRouter {
 public:
     TransportRouter(const transport_catalogue::TransportCatalogue& transport_catalogue);
     
-    TransportRouter(const serialization::TransportCatalogue& transport_catalogue, const transport_catalogue::TransportCatalogue& transport_catalogue_usual);
+    TransportRouter(const serialization::RouterGraph& router_graph, const serialization::RoutesTable* routes_table);
     
     std::optional<graph::Router<double>::RouteInfo> BuildRoute(std::string_view from, std::string_view to) const;
     
@@ -29,6 +29,14 @@ public:
     
     void BuildRouter() const;
     
+    // Строит матрицу маршрутов, используя матрицу предыдущей версии базы:
+    // пересчитываются только строки, маршруты которых затронуты изменившимися рёбрами
+    void BuildRouterFrom(const TransportRouter& previous) const;
+    
+    // Добавляет в граф рёбра нового автобуса каталога и дополняет ими матрицу маршрутов
+    // без её полного перестроения. Остановки автобуса уже должны быть в графе
+    void AddBus(const BusPtr& bus) const;
+    
     const graph::DirectedWeightedGraph<double>& GetGraph() const;
     
     const graph::Router<double>* GetRouter() const;
@@ -36,7 +44,7 @@ public:
     const std::vector<Vertex>& GetIdToVertex() const;
     
 private:
-    const TransportCatalogue& transport_catalogue_;
+    const TransportCatalogue* transport_catalogue_ = nullptr;
     mutable std::unique_ptr<graph::Router<double>> router_;
     mutable graph::DirectedWeightedGraph<double> graph_;
     mutable std::map<Vertex, size_t> vertex_to_id_;
@@ -50,13 +58,15 @@ private:
     
     void AddEdgesBetweenStops(const std::vector<StopPtr>& stops, const BusPtr& bus, double velocity) const;
     
-    void SetIdToVertex(const serialization::TransportCatalogue& transport_catalogue) const;
+    void SetIdToVertex(const serialization::RouterGraph& router_graph) const;
     
     void SetVertexToId() const;
     
     graph::DirectedWeightedGraph<double> SetGraph(const serialization::Graph& graph) const;
     
-    std::unique_ptr<graph::Router<double>> SetRouter(const serialization::Router& router) const;
+    std::unique_ptr<graph::Router<double>> SetRouter(const serialization::RoutesTable* routes_table) const;
+    
+    graph::Router<double>::RoutesInternalData SetRoutesTable(const serialization::RoutesTable& routes_table) const;
     
 };
     